@@ -0,0 +1,441 @@
+/**
+ * File: bench.c
+ *
+ * Benchmark suite for the parallel Game of Life. Runs every combination of
+ * board size, starting pattern, thread count and kernel, and prints one
+ * line of results per combination as CSV (default) or JSON lines. Every
+ * combination can also be run under several rules.
+ *
+ * Starting patterns are either random fills with a given density of live
+ * cells, or config files (see initialize_world) tiled across the board.
+ */
+
+#define _XOPEN_SOURCE 600
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <string.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <math.h>
+
+#include "gol.h"
+#include "bitworld.h"
+#include "sim.h"
+
+#define MAX_LIST 32
+
+/**
+ * Function that prints out how to use the program, in case the user forgets.
+ *
+ * @param prog_name The name of the executable.
+ */
+static void usage(char *prog_name) {
+	fprintf(stderr, "usage: %s [-j] [-a] [-s <sizes>] [-r <densities in %%>] [-f <config-files>] "
+			"[-p <thread counts>] [-k <kernels>] [-t <number of turns>] "
+			"[-w <warmup turns>] [-m <max int-kernel size>] [-b <generations per tile visit>] "
+			"[-R <rules>]\n",
+			prog_name);
+	fprintf(stderr, "lists are comma-separated, e.g. -s 256,1024 -k swar,avx2 -R B3/S23,B36/S23\n");
+	exit(1);
+}
+
+/**
+ * Parses a comma-separated list of positive integers.
+ *
+ * @param arg The list to parse.
+ * @param values Location where to store the values (at most MAX_LIST).
+ *
+ * @return The number of values, or -1 if the list is invalid.
+ */
+static int parse_ints(const char *arg, int *values) {
+	int n = 0;
+	const char *p = arg;
+	while (*p != '\0') {
+		char *end;
+		long v = strtol(p, &end, 10);
+		if (end == p || v <= 0 || n == MAX_LIST || (*end != ',' && *end != '\0')) {
+			return -1;
+		}
+		values[n++] = (int)v;
+		p = (*end == ',') ? end + 1 : end;
+	}
+	return n;
+}
+
+/**
+ * Splits a comma-separated list of names in place.
+ *
+ * @param arg The list to split; its commas are overwritten.
+ * @param names Location where to store the names (at most MAX_LIST).
+ *
+ * @return The number of names, or -1 if the list has too many of them.
+ */
+static int split_names(char *arg, char **names) {
+	int n = 0;
+	for (char *tok = strtok(arg, ","); tok != NULL; tok = strtok(NULL, ",")) {
+		if (n == MAX_LIST) {
+			return -1;
+		}
+		names[n++] = tok;
+	}
+	return n;
+}
+
+/**
+ * Returns the next number of a xorshift64 sequence. The boards only need to
+ * look random and be the same for every kernel, not be high quality.
+ */
+static uint64_t next_random(uint64_t *state) {
+	uint64_t x = *state;
+	x ^= x << 13;
+	x ^= x >> 7;
+	x ^= x << 17;
+	*state = x;
+	return x;
+}
+
+/**
+ * Fills an empty world with live cells, each one with the given probability.
+ *
+ * @param engine The engine of the world.
+ * @param world The world to fill.
+ * @param size The width and height of the world.
+ * @param density Percentage of cells to make alive.
+ */
+static void fill_random(const Engine *engine, void *world, int size, int density) {
+	uint64_t state = 0x9E3779B97F4A7C15ull ^ ((uint64_t)size << 8) ^ density;
+	uint64_t threshold = (uint64_t)(density / 100.0 * (double)UINT64_MAX);
+
+	for (int row = 0; row < size; row++) {
+		for (int col = 0; col < size; col++) {
+			if (next_random(&state) < threshold) {
+				engine->set(world, col, row, 1);
+			}
+		}
+	}
+}
+
+/**
+ * Fills an empty world with copies of a world read by initialize_world,
+ * repeated across and down the board.
+ *
+ * @param engine The engine of the world.
+ * @param world The world to fill.
+ * @param size The width and height of the world.
+ * @param tile The int-per-cell world to repeat.
+ * @param tile_cols The width of tile.
+ * @param tile_rows The height of tile.
+ */
+static void fill_tiled(const Engine *engine, void *world, int size,
+		int *tile, int tile_cols, int tile_rows) {
+	for (int row = 0; row < size; row++) {
+		for (int col = 0; col < size; col++) {
+			unsigned index = translate_to_1D(col % tile_cols, row % tile_rows, tile_cols, tile_rows);
+			if (tile[index] == 1) {
+				engine->set(world, col, row, 1);
+			}
+		}
+	}
+}
+
+static int compare_doubles(const void *a, const void *b) {
+	double x = *(const double *)a, y = *(const double *)b;
+	return (x > y) - (x < y);
+}
+
+/**
+ * Returns the given percentile (nearest rank) of an array of n sorted values.
+ */
+static double percentile(const double *sorted, int n, double pct) {
+	int rank = (int)ceil(pct / 100.0 * n);
+	return sorted[(rank > 0) ? rank - 1 : 0];
+}
+
+/**
+ * Settings shared by every benchmark run.
+ */
+typedef struct BenchOptions {
+	int num_turns;	// generations timed per run
+	int warmup_turns;	// untimed generations run first
+	int block_turns;	// generations per tile visit (bit-packed kernels)
+	bool json;	// print JSON lines instead of CSV
+} BenchOptions;
+
+/**
+ * Simulates a copy of the starting world and prints one line of results.
+ *
+ * @param pool The thread pool to simulate on.
+ * @param engine The engine of the world.
+ * @param start The starting world (left unchanged).
+ * @param work A world of the same size to simulate in.
+ * @param size The width and height of the world.
+ * @param pattern Name of the starting pattern.
+ * @param kernel Name of the kernel.
+ * @param rule Name of the rule the engine simulates.
+ * @param num_threads Number of threads to simulate with.
+ * @param bench The benchmark settings.
+ * @param turn_seconds Scratch space for num_turns per-generation times.
+ */
+static void bench_one(SimPool *pool, const Engine *engine, const void *start, void *work, int size,
+		const char *pattern, const char *kernel, const char *rule, int num_threads,
+		const BenchOptions *bench, double *turn_seconds) {
+	SimOptions opts = {
+		.num_threads = num_threads,
+		.num_turns = bench->warmup_turns,
+		.verbose = false,
+		.turn_seconds = NULL,
+		.block_turns = bench->block_turns,
+	};
+	// the int kernel computes one generation per visit whatever is asked
+	int block_turns = (engine->update_block != NULL) ? bench->block_turns : 1;
+
+	engine->copy(work, start);
+	if (bench->warmup_turns > 0) {
+		sim_pool_run(pool, engine, work, size, size, &opts);
+	}
+
+	opts.num_turns = bench->num_turns;
+	opts.turn_seconds = turn_seconds;
+	sim_pool_run(pool, engine, work, size, size, &opts);
+
+	double total = 0;
+	for (int t = 0; t < bench->num_turns; t++) {
+		total += turn_seconds[t];
+	}
+	qsort(turn_seconds, bench->num_turns, sizeof(double), compare_doubles);
+	double median = percentile(turn_seconds, bench->num_turns, 50);
+	double p99 = percentile(turn_seconds, bench->num_turns, 99);
+	double updates = (double)bench->num_turns * size * size / total;
+
+	if (bench->json) {
+		fprintf(stdout, "{\"pattern\": \"%s\", \"width\": %d, \"height\": %d, "
+				"\"threads\": %d, \"kernel\": \"%s\", \"rule\": \"%s\", \"block_turns\": %d, \"turns\": %d, "
+				"\"total_s\": %.6f, \"median_gen_ms\": %.4f, \"p99_gen_ms\": %.4f, "
+				"\"cell_updates_per_s\": %.4g}\n",
+				pattern, size, size, num_threads, kernel, rule, block_turns, bench->num_turns,
+				total, median * 1e3, p99 * 1e3, updates);
+	}
+	else {
+		fprintf(stdout, "%s,%d,%d,%d,%s,%s,%d,%d,%.6f,%.4f,%.4f,%.4g\n",
+				pattern, size, size, num_threads, kernel, rule, block_turns, bench->num_turns,
+				total, median * 1e3, p99 * 1e3, updates);
+	}
+	fflush(stdout);
+}
+
+/*
+ * Main function to run the benchmark matrix.
+ *
+ * @param argc, number of arguments
+ * @param *argv[] the arguments in an array
+ */
+int main(int argc, char *argv[]) {
+	int sizes[MAX_LIST] = {256, 1024, 4096, 16384, 32768};
+	int num_sizes = 5;
+	int densities[MAX_LIST] = {10, 20, 30, 40, 50};
+	int num_densities = 5;
+	char *files[MAX_LIST] = {"r-pentomino.txt", "diehard.txt", "multi-oscillator.txt"};
+	int num_files = 3;
+	int threads[MAX_LIST] = {1, 2, 4, 8};
+	int num_thread_counts = 4;
+	char *kernels[MAX_LIST] = {"int", "byte", "lut", "swar", "sse2", "avx2", "avx512"};
+	int num_kernels = 7;
+	char *rule_names[MAX_LIST] = {"B3/S23"};
+	int num_rules = 1;
+	Rule rules[MAX_LIST];
+	// the int world takes 32x the memory of the bit-packed one, so by
+	// default it is only run on boards up to this size
+	int max_int_size = 4096;
+	// the nearest-rank p99 of fewer than 100 generations is their maximum
+	BenchOptions bench = {.num_turns = 100, .warmup_turns = 2, .block_turns = 1, .json = false};
+	bool pin_threads = false;	// pin the threads to CPUs, spread over NUMA nodes
+	char ch;
+
+	while ((ch = getopt(argc, argv, "s:r:f:p:k:t:w:m:b:jaR:")) != -1) {
+		switch (ch) {
+			case 's':
+				num_sizes = parse_ints(optarg, sizes);
+				break;
+			case 'r':
+				num_densities = (strcmp(optarg, "none") == 0) ? 0 : parse_ints(optarg, densities);
+				break;
+			case 'f':
+				num_files = (strcmp(optarg, "none") == 0) ? 0 : split_names(optarg, files);
+				break;
+			case 'p':
+				num_thread_counts = parse_ints(optarg, threads);
+				break;
+			case 'k':
+				num_kernels = split_names(optarg, kernels);
+				break;
+			case 't':
+				if (sscanf(optarg, "%d", &bench.num_turns) != 1 || bench.num_turns <= 0) {
+					fprintf(stderr, "Invalid value for -t: %s\n", optarg);
+					usage(argv[0]);
+				}
+				break;
+			case 'w':
+				if (sscanf(optarg, "%d", &bench.warmup_turns) != 1 || bench.warmup_turns < 0) {
+					fprintf(stderr, "Invalid value for -w: %s\n", optarg);
+					usage(argv[0]);
+				}
+				break;
+			case 'm':
+				if (sscanf(optarg, "%d", &max_int_size) != 1) {
+					fprintf(stderr, "Invalid value for -m: %s\n", optarg);
+					usage(argv[0]);
+				}
+				break;
+			case 'b':
+				if (sscanf(optarg, "%d", &bench.block_turns) != 1
+						|| bench.block_turns < 1 || bench.block_turns > 64) {
+					fprintf(stderr, "Invalid value for -b (1 to 64): %s\n", optarg);
+					usage(argv[0]);
+				}
+				break;
+			case 'j':
+				bench.json = true;
+				break;
+			case 'a':
+				pin_threads = true;
+				break;
+			case 'R':
+				num_rules = split_names(optarg, rule_names);
+				break;
+			default:
+				usage(argv[0]);
+		}
+	}
+
+	if (bench.num_turns < 100) {
+		fprintf(stderr, "With fewer than 100 timed turns, p99_gen_ms is the slowest generation\n");
+	}
+
+	if (num_sizes <= 0 || num_densities < 0 || num_files < 0
+			|| num_thread_counts <= 0 || num_kernels <= 0 || num_rules <= 0) {
+		fprintf(stderr, "Invalid list argument\n");
+		usage(argv[0]);
+	}
+	for (int k = 0; k < num_kernels; k++) {
+		if (strcmp(kernels[k], "int") != 0 && strcmp(kernels[k], "byte") != 0
+				&& bitworld_select_kernel(kernels[k]) != 0) {
+			fprintf(stderr, "Skipping unknown or unsupported kernel: %s\n", kernels[k]);
+			kernels[k--] = kernels[--num_kernels];
+		}
+	}
+
+	for (int r = 0; r < num_rules; r++) {
+		if (rule_parse(rule_names[r], &rules[r]) != 0) {
+			fprintf(stderr, "Invalid rule: %s\n", rule_names[r]);
+			usage(argv[0]);
+		}
+	}
+
+	// read the config files once; they are tiled onto every board size
+	int *tiles[MAX_LIST];
+	int tile_cols[MAX_LIST], tile_rows[MAX_LIST];
+	for (int f = 0; f < num_files; f++) {
+		Rule tile_rule;	// the boards are simulated under the rules of -R
+		tiles[f] = initialize_world(files[f], &tile_cols[f], &tile_rows[f], &tile_rule);
+		if (tiles[f] == NULL) {
+			fprintf(stderr, "Error initializing the world from %s.\n", files[f]);
+			exit(1);
+		}
+	}
+
+	double *turn_seconds = malloc(bench.num_turns * sizeof(double));
+	if (turn_seconds == NULL) {
+		perror("malloc");
+		exit(EXIT_FAILURE);
+	}
+
+	// one set of threads for the whole matrix, as many as the largest count
+	int max_threads = 0;
+	for (int t = 0; t < num_thread_counts; t++) {
+		if (threads[t] > max_threads) {
+			max_threads = threads[t];
+		}
+	}
+	SimPool *pool = sim_pool_create(max_threads, pin_threads);
+	if (pool == NULL) {
+		perror("sim_pool_create");
+		exit(EXIT_FAILURE);
+	}
+
+	if (!bench.json) {
+		fprintf(stdout, "pattern,width,height,threads,kernel,rule,block_turns,turns,total_s,"
+				"median_gen_ms,p99_gen_ms,cell_updates_per_s\n");
+	}
+
+	for (int s = 0; s < num_sizes; s++) {
+		int size = sizes[s];
+		for (int pat = 0; pat < num_densities + num_files; pat++) {
+			char pattern[64];
+			if (pat < num_densities) {
+				snprintf(pattern, sizeof(pattern), "random%d", densities[pat]);
+			}
+			else {
+				snprintf(pattern, sizeof(pattern), "%s", files[pat - num_densities]);
+			}
+
+			// the starting world and a work copy for each engine, built the
+			// first time a kernel needs them
+			const Engine *engines[3] = {&int_engine, &byte_engine, &bit_engine};
+			void *start[3] = {NULL, NULL, NULL}, *work[3] = {NULL, NULL, NULL};
+
+			for (int k = 0; k < num_kernels; k++) {
+				int e = (strcmp(kernels[k], "int") == 0) ? 0 : (strcmp(kernels[k], "byte") == 0) ? 1 : 2;
+				const Engine *engine = engines[e];
+				if (e == 0 && size > max_int_size) {
+					continue;
+				}
+				if (e == 2) {
+					bitworld_select_kernel(kernels[k]);
+				}
+
+				if (start[e] == NULL) {
+					start[e] = engine->create(size, size);
+					work[e] = engine->create(size, size);
+					if (start[e] == NULL || work[e] == NULL) {
+						fprintf(stderr, "Error allocating a %dx%d world.\n", size, size);
+						exit(1);
+					}
+					if (pat < num_densities) {
+						fill_random(engine, start[e], size, densities[pat]);
+					}
+					else {
+						int f = pat - num_densities;
+						fill_tiled(engine, start[e], size, tiles[f], tile_cols[f], tile_rows[f]);
+					}
+				}
+
+				for (int r = 0; r < num_rules; r++) {
+					engine->set_rule(&rules[r]);
+					for (int t = 0; t < num_thread_counts; t++) {
+						if (threads[t] > size) {
+							continue;
+						}
+						bench_one(pool, engine, start[e], work[e], size, pattern, kernels[k],
+								rule_names[r], threads[t], &bench, turn_seconds);
+					}
+				}
+			}
+
+			for (int e = 0; e < 3; e++) {
+				if (start[e] != NULL) {
+					engines[e]->destroy(start[e]);
+					engines[e]->destroy(work[e]);
+				}
+			}
+		}
+	}
+
+	for (int f = 0; f < num_files; f++) {
+		free(tiles[f]);
+	}
+	sim_pool_free(pool);
+	free(turn_seconds);
+	return 0;
+}
@@ -0,0 +1,878 @@
+/**
+ * File: bitworld.c
+ *
+ * Implementation of the bit-packed world and its bit-sliced update kernels,
+ * with SIMD variants selected at runtime based on what the CPU supports.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <sys/mman.h>
+
+#include "gol.h"
+#include "bitworld.h"
+
+BitWorld *bitworld_create(int num_cols, int num_rows) {
+	BitWorld *bw = malloc(sizeof(BitWorld));
+	if (bw == NULL) {
+		return NULL;
+	}
+
+	bw->num_cols = num_cols;
+	bw->num_rows = num_rows;
+	bw->words_per_row = (num_cols + 63) / 64;
+	bw->tiles_per_row = (bw->words_per_row + BITWORLD_TILE_WORDS - 1) / BITWORLD_TILE_WORDS;
+	bw->cells = calloc((size_t)bw->words_per_row * num_rows, sizeof(uint64_t));
+	bw->changed = malloc((size_t)bw->tiles_per_row * num_rows);
+	bw->mapping = NULL;
+	bw->mapping_size = 0;
+	if (bw->cells == NULL || bw->changed == NULL) {
+		free(bw->cells);
+		free(bw->changed);
+		free(bw);
+		return NULL;
+	}
+
+	bitworld_mark_all_changed(bw);
+	return bw;
+}
+
+BitWorld *bitworld_from_mapping(int num_cols, int num_rows, void *mapping, size_t mapping_size,
+		size_t cells_offset) {
+	BitWorld *bw = malloc(sizeof(BitWorld));
+	if (bw == NULL) {
+		return NULL;
+	}
+
+	bw->num_cols = num_cols;
+	bw->num_rows = num_rows;
+	bw->words_per_row = (num_cols + 63) / 64;
+	bw->tiles_per_row = (bw->words_per_row + BITWORLD_TILE_WORDS - 1) / BITWORLD_TILE_WORDS;
+	bw->cells = (uint64_t *)((char *)mapping + cells_offset);
+	bw->changed = malloc((size_t)bw->tiles_per_row * num_rows);
+	bw->mapping = mapping;
+	bw->mapping_size = mapping_size;
+	if (bw->changed == NULL) {
+		free(bw);
+		return NULL;
+	}
+
+	bitworld_mark_all_changed(bw);
+	return bw;
+}
+
+BitWorld *bitworld_from_cells(int *world, int num_cols, int num_rows) {
+	BitWorld *bw = bitworld_create(num_cols, num_rows);
+	if (bw == NULL) {
+		return NULL;
+	}
+
+	for (int row = 0; row < num_rows; row++) {
+		for (int col = 0; col < num_cols; col++) {
+			if (world[translate_to_1D(col, row, num_cols, num_rows)] == 1) {
+				bitworld_set(bw, col, row, 1);
+			}
+		}
+	}
+
+	return bw;
+}
+
+void bitworld_to_cells(const BitWorld *bw, int *world) {
+	for (int row = 0; row < bw->num_rows; row++) {
+		for (int col = 0; col < bw->num_cols; col++) {
+			unsigned index = translate_to_1D(col, row, bw->num_cols, bw->num_rows);
+			world[index] = bitworld_get(bw, col, row);
+		}
+	}
+
+	update_halo(world, bw->num_cols, bw->num_rows, 0, bw->num_rows - 1);
+}
+
+int64_t bitworld_count(const BitWorld *bw, int col, int row, int num_cols, int num_rows) {
+	int first_word = col >> 6;
+	int last_word = (col + num_cols - 1) >> 6;
+	uint64_t first_mask = ~(uint64_t)0 << (col & 63);
+	uint64_t last_mask = ~(uint64_t)0 >> (63 - ((col + num_cols - 1) & 63));
+	if (first_word == last_word) {
+		first_mask &= last_mask;
+	}
+
+	int64_t count = 0;
+	for (int y = row; y < row + num_rows; y++) {
+		const uint64_t *words = bitworld_row(bw, y);
+		count += __builtin_popcountll(words[first_word] & first_mask);
+		if (last_word > first_word) {
+			for (int w = first_word + 1; w < last_word; w++) {
+				count += __builtin_popcountll(words[w]);
+			}
+			count += __builtin_popcountll(words[last_word] & last_mask);
+		}
+	}
+	return count;
+}
+
+void bitworld_copy(BitWorld *dst, const BitWorld *src) {
+	memcpy(dst->cells, src->cells,
+			(size_t)src->words_per_row * src->num_rows * sizeof(uint64_t));
+	bitworld_mark_all_changed(dst);
+}
+
+void bitworld_mark_all_changed(BitWorld *bw) {
+	memset(bw->changed, 1, (size_t)bw->tiles_per_row * bw->num_rows);
+}
+
+void bitworld_free(BitWorld *bw) {
+	if (bw == NULL) {
+		return;
+	}
+	if (bw->mapping != NULL) {
+		munmap(bw->mapping, bw->mapping_size);
+	}
+	else {
+		free(bw->cells);
+	}
+	free(bw->changed);
+	free(bw);
+}
+
+/**
+ * Returns word i of the given row shifted so that bit x holds cell x-1,
+ * wrapping the last column of the row around into column 0.
+ *
+ * @param row The row to shift.
+ * @param i Index of the word within the row.
+ * @param last_word Index of the last word in the row.
+ * @param last_bit Bit position of the last column within the last word.
+ */
+static inline uint64_t west_neighbors(const uint64_t *row, int i,
+									int last_word, int last_bit) {
+	uint64_t carry = (i > 0) ? row[i - 1] >> 63
+							: (row[last_word] >> last_bit) & 1;
+	return (row[i] << 1) | carry;
+}
+
+/**
+ * Returns word i of the given row shifted so that bit x holds cell x+1,
+ * wrapping column 0 of the row around into the last column.
+ *
+ * @param row The row to shift.
+ * @param i Index of the word within the row.
+ * @param last_word Index of the last word in the row.
+ * @param last_bit Bit position of the last column within the last word.
+ */
+static inline uint64_t east_neighbors(const uint64_t *row, int i,
+									int last_word, int last_bit) {
+	uint64_t carry = (i < last_word) ? row[i + 1] << 63
+									: (row[0] & 1) << last_bit;
+	return (row[i] >> 1) | carry;
+}
+
+/*
+ * Vector types used by the SIMD row kernels. GCC supports the C bitwise
+ * and shift operators on these lane-wise, so the adder network below is
+ * written once and instantiated for every width.
+ */
+typedef uint64_t u64x2 __attribute__((vector_size(16)));
+typedef uint64_t u64x4 __attribute__((vector_size(32)));
+typedef uint64_t u64x8 __attribute__((vector_size(64)));
+
+#if defined(__x86_64__) || defined(__i386__)
+#define BITWORLD_X86 1
+#endif
+
+/**
+ * Defines a function computing the next state of 64 cells (per lane) at once
+ * from the words holding their eight neighbors. The neighbor count is never
+ * materialized: each row's contribution is summed with bit-sliced full/half
+ * adders, so bit x of the result only depends on bit x of the inputs.
+ *
+ * Arguments of the generated function:
+ *   nw,n,ne Row above, shifted west / unshifted / shifted east.
+ *   w,c,e   Current row, shifted west / the cells themselves / shifted east.
+ *   sw,s,se Row below, shifted west / unshifted / shifted east.
+ *
+ * @param name Name of the function to define.
+ * @param T Word type: uint64_t or one of the vector types.
+ * @param ... Extra attributes for the function (e.g. a target ISA).
+ */
+#define DEFINE_LIFE_WORD(name, T, ...) \
+__VA_ARGS__ static inline T name(T nw, T n, T ne, T w, T c, T e, \
+									T sw, T s, T se) { \
+	/* 2-bit sums of the row above (a), the row below (b) and the two */ \
+	/* horizontal neighbors in the current row (m) */ \
+	T a_x = nw ^ n; \
+	T a0 = a_x ^ ne; \
+	T a1 = (nw & n) | (a_x & ne); \
+	T b_x = sw ^ s; \
+	T b0 = b_x ^ se; \
+	T b1 = (sw & s) | (b_x & se); \
+	T m0 = w ^ e; \
+	T m1 = w & e; \
+	\
+	/* add the three 2-bit sums: bit 0 of the count and its carry */ \
+	T ones_x = a0 ^ b0; \
+	T ones = ones_x ^ m0; \
+	T carry = (a0 & b0) | (ones_x & m0); \
+	\
+	/* twos digit, plus everything that would make the count 4 or more */ \
+	T twos_x = a1 ^ b1; \
+	T twos_y = twos_x ^ m1; \
+	T fours = (a1 & b1) | (twos_x & m1); \
+	T twos = twos_y ^ carry; \
+	fours |= twos_y & carry; \
+	\
+	/* alive next turn iff count is 3, or count is 2 and the cell is alive */ \
+	return twos & ~fours & (ones | c); \
+}
+
+// bits of a where x is set, of b elsewhere
+#define BITWORLD_MUX(x, a, b) ((b) ^ ((x) & ((a) ^ (b))))
+
+// the next state of cells c of type T with k live neighbors under a rule:
+// 0, c, ~c or all ones, a constant if the rule is
+#define BITWORLD_LEAF(T, c, birth, survive, k) \
+	((((T){0} - (uint64_t)(((birth) >> (k)) & 1)) & ~(c)) \
+		| (((T){0} - (uint64_t)(((survive) >> (k)) & 1)) & (c)))
+
+/**
+ * Defines a function computing the next state of 64 cells (per lane) at once
+ * under any outer-totalistic rule, with the same arguments as the functions
+ * DEFINE_LIFE_WORD defines. The neighbor count is added up into bit-sliced
+ * digits, which then pick the state for that count out of a tree of
+ * multiplexers whose leaves are the rule's transitions. When birth and
+ * survive are constants the leaves are 0, the cell, its complement or 1,
+ * and the tree folds down to the few gates the rule needs, like the
+ * hand-written Life function. It only folds once inlined into the row
+ * kernel, so the function is always inlined even though it looks large.
+ *
+ * @param name Name of the function to define.
+ * @param T Word type: uint64_t or one of the vector types.
+ * @param birth,survive Neighbor count masks of the rule (see Rule).
+ * @param ... Extra attributes for the function (e.g. a target ISA).
+ */
+#define DEFINE_RULE_WORD(name, T, birth, survive, ...) \
+__VA_ARGS__ __attribute__((always_inline)) static inline T name(T nw, T n, T ne, \
+									T w, T c, T e, T sw, T s, T se) { \
+	T a_x = nw ^ n; \
+	T a0 = a_x ^ ne; \
+	T a1 = (nw & n) | (a_x & ne); \
+	T b_x = sw ^ s; \
+	T b0 = b_x ^ se; \
+	T b1 = (sw & s) | (b_x & se); \
+	T m0 = w ^ e; \
+	T m1 = w & e; \
+	\
+	T ones_x = a0 ^ b0; \
+	T ones = ones_x ^ m0; \
+	T carry = (a0 & b0) | (ones_x & m0); \
+	\
+	/* a1 + b1 + m1 + carry is at most 4, so the eights digit is only */ \
+	/* set for a count of 8, and the other digits are 0 then */ \
+	T twos_x = a1 ^ b1; \
+	T twos_y = twos_x ^ m1; \
+	T fours_x = (a1 & b1) | (twos_x & m1); \
+	T fours_y = twos_y & carry; \
+	T twos = twos_y ^ carry; \
+	T fours = fours_x ^ fours_y; \
+	\
+	/* the state after each count, and the tree picking one by count */ \
+	T m01 = BITWORLD_MUX(ones, BITWORLD_LEAF(T, c, birth, survive, 1), \
+			BITWORLD_LEAF(T, c, birth, survive, 0)); \
+	T m23 = BITWORLD_MUX(ones, BITWORLD_LEAF(T, c, birth, survive, 3), \
+			BITWORLD_LEAF(T, c, birth, survive, 2)); \
+	T m45 = BITWORLD_MUX(ones, BITWORLD_LEAF(T, c, birth, survive, 5), \
+			BITWORLD_LEAF(T, c, birth, survive, 4)); \
+	T m67 = BITWORLD_MUX(ones, BITWORLD_LEAF(T, c, birth, survive, 7), \
+			BITWORLD_LEAF(T, c, birth, survive, 6)); \
+	T m03 = BITWORLD_MUX(twos, m23, m01); \
+	T m47 = BITWORLD_MUX(twos, m67, m45); \
+	T next = BITWORLD_MUX(fours, m47, m03); \
+	if (((((birth) ^ ((birth) >> 8)) | ((survive) ^ ((survive) >> 8))) & 1) != 0) { \
+		/* 8 neighbors leave the other digits at 0, as for a count of 0, */ \
+		/* so this is only needed when those two counts differ */ \
+		next = BITWORLD_MUX(fours_x & fours_y, BITWORLD_LEAF(T, c, birth, survive, 8), next); \
+	} \
+	return next; \
+}
+
+// rules with kernels compiled for them besides Life
+#define HIGHLIFE_BIRTH ((1 << 3) | (1 << 6))
+#define HIGHLIFE_SURVIVE ((1 << 2) | (1 << 3))
+#define DAYNIGHT_BIRTH ((1 << 3) | (1 << 6) | (1 << 7) | (1 << 8))
+#define DAYNIGHT_SURVIVE ((1 << 3) | (1 << 4) | (1 << 6) | (1 << 7) | (1 << 8))
+#define SEEDS_BIRTH (1 << 2)
+#define SEEDS_SURVIVE 0
+
+// the rule of the kernels for any other rule, which read it at run time
+static uint16_t rule_birth = 1 << 3;
+static uint16_t rule_survive = (1 << 2) | (1 << 3);
+
+DEFINE_LIFE_WORD(word_life, uint64_t)
+DEFINE_RULE_WORD(word_highlife, uint64_t, HIGHLIFE_BIRTH, HIGHLIFE_SURVIVE)
+DEFINE_RULE_WORD(word_daynight, uint64_t, DAYNIGHT_BIRTH, DAYNIGHT_SURVIVE)
+DEFINE_RULE_WORD(word_seeds, uint64_t, SEEDS_BIRTH, SEEDS_SURVIVE)
+DEFINE_RULE_WORD(word_rule, uint64_t, rule_birth, rule_survive)
+
+/**
+ * Defines a function computing the next state of word i of a row with one
+ * of the word functions, handling the wraparound at either end of the row
+ * and keeping the padding bits of the last word at 0.
+ *
+ * Arguments of the generated function:
+ *   above,here,below The row being computed and its neighbors.
+ *   out              Location where to store the new row.
+ *   i                Index of the word within the row.
+ *   last_word        Index of the last word in the row.
+ *   last_bit         Bit position of the last column within the last word.
+ * It returns the bits of the word that changed.
+ *
+ * @param name Name of the function to define.
+ * @param word Word function for uint64_t.
+ */
+#define DEFINE_WORD_STORE(name, word) \
+static inline uint64_t name(const uint64_t *above, const uint64_t *here, \
+								const uint64_t *below, uint64_t *out, int i, \
+								int last_word, int last_bit) { \
+	uint64_t next = word( \
+			west_neighbors(above, i, last_word, last_bit), above[i], \
+			east_neighbors(above, i, last_word, last_bit), \
+			west_neighbors(here, i, last_word, last_bit), here[i], \
+			east_neighbors(here, i, last_word, last_bit), \
+			west_neighbors(below, i, last_word, last_bit), below[i], \
+			east_neighbors(below, i, last_word, last_bit)); \
+	if (i == last_word) { \
+		/* shifting west pushes the last column into the padding bits */ \
+		next &= ~(uint64_t)0 >> (63 - last_bit); \
+	} \
+	out[i] = next; \
+	return next ^ here[i]; \
+}
+
+/**
+ * A row kernel computes tiles first_tile through last_tile of one row of the
+ * next generation, and records which of them changed. A tile may be marked
+ * as changed when it did not (costing a recomputation later), but never the
+ * other way around.
+ *
+ * @param above,here,below The row being computed and its neighbors.
+ * @param out Location where to store the new row.
+ * @param changed Location where to store the change flags of the new row.
+ * @param first_tile Index of the first tile to compute.
+ * @param last_tile Index of the last tile to compute.
+ * @param last_word Index of the last word in the row.
+ * @param last_bit Bit position of the last column within the last word.
+ */
+typedef void (*row_kernel)(const uint64_t *above, const uint64_t *here,
+							const uint64_t *below, uint64_t *out,
+							uint8_t *changed, int first_tile, int last_tile,
+							int last_word, int last_bit);
+
+/**
+ * Defines a portable row kernel, one 64-bit word at a time. Every other
+ * kernel of the same rule must produce bit-identical results.
+ *
+ * @param name Name of the row kernel to define.
+ * @param store Store function of the rule, defined with DEFINE_WORD_STORE.
+ */
+#define DEFINE_SWAR_KERNEL(name, store) \
+static void name(const uint64_t *above, const uint64_t *here, \
+						const uint64_t *below, uint64_t *out, \
+						uint8_t *changed, int first_tile, int last_tile, \
+						int last_word, int last_bit) { \
+	for (int t = first_tile; t <= last_tile; t++) { \
+		int i = t * BITWORLD_TILE_WORDS; \
+		int last = (i + BITWORLD_TILE_WORDS - 1 < last_word) ? i + BITWORLD_TILE_WORDS - 1 : last_word; \
+		uint64_t diff = 0; \
+		for (; i <= last; i++) { \
+			diff |= store(above, here, below, out, i, last_word, last_bit); \
+		} \
+		changed[t] = (diff != 0); \
+	} \
+}
+
+DEFINE_WORD_STORE(store_life, word_life)
+DEFINE_WORD_STORE(store_highlife, word_highlife)
+DEFINE_WORD_STORE(store_daynight, word_daynight)
+DEFINE_WORD_STORE(store_seeds, word_seeds)
+DEFINE_WORD_STORE(store_rule, word_rule)
+DEFINE_SWAR_KERNEL(row_swar_life, store_life)
+DEFINE_SWAR_KERNEL(row_swar_highlife, store_highlife)
+DEFINE_SWAR_KERNEL(row_swar_daynight, store_daynight)
+DEFINE_SWAR_KERNEL(row_swar_seeds, store_seeds)
+DEFINE_SWAR_KERNEL(row_swar_rule, store_rule)
+
+// cells of a row the lookup table kernel computes per lookup, and the width
+// of the window of each row they depend on
+#define LUT_CELLS 4
+#define LUT_WIDTH (LUT_CELLS + 2)
+#define LUT_MASK ((1u << LUT_WIDTH) - 1)
+
+// the next state of LUT_CELLS cells for every window of three rows around
+// them: bits 0 to LUT_WIDTH - 1 of the index are the row above, then the
+// row itself and the row below, each from the cell west of the first to
+// the cell east of the last (see build_lut)
+static uint8_t lut[1 << (3 * LUT_WIDTH)];
+
+/**
+ * Fills lut for the rule in rule_birth and rule_survive.
+ */
+static void build_lut(void) {
+	for (uint32_t idx = 0; idx < (1u << (3 * LUT_WIDTH)); idx++) {
+		uint32_t above = idx & LUT_MASK;
+		uint32_t here = (idx >> LUT_WIDTH) & LUT_MASK;
+		uint32_t below = (idx >> (2 * LUT_WIDTH)) & LUT_MASK;
+		uint8_t next = 0;
+		for (int k = 0; k < LUT_CELLS; k++) {
+			// cell k is at bit k + 1 of each window
+			int live = __builtin_popcount((above >> k) & 7) + __builtin_popcount((below >> k) & 7)
+					+ ((here >> k) & 1) + ((here >> (k + 2)) & 1);
+			uint16_t mask = ((here >> (k + 1)) & 1) ? rule_survive : rule_birth;
+			next |= ((mask >> live) & 1) << k;
+		}
+		lut[idx] = next;
+	}
+}
+
+/**
+ * Computes the next state of 64 cells, LUT_CELLS at a time, by looking up
+ * the windows of three rows around them in lut, with the same arguments as
+ * the word functions. This works for any rule, which only changes the
+ * table, and needs no wide registers, but makes 64 / LUT_CELLS dependent
+ * loads per word where the bit-sliced kernels make none.
+ */
+static inline uint64_t word_lut(uint64_t nw, uint64_t n, uint64_t ne, uint64_t w, uint64_t c,
+								uint64_t e, uint64_t sw, uint64_t s, uint64_t se) {
+	(void)n;
+	(void)c;
+	(void)s;
+	uint64_t next = 0;
+	for (int j = 0; j < 64; j += LUT_CELLS) {
+		// cells j - 1 and j are bits j and j + 1 of the west shifted row,
+		// cells j + 1 onwards bits j onwards of the east shifted one (which
+		// also holds the wraparound, in the last word of the row)
+		uint32_t above = ((nw >> j) & 3) | (((ne >> j) & ((1u << LUT_CELLS) - 1)) << 2);
+		uint32_t here = ((w >> j) & 3) | (((e >> j) & ((1u << LUT_CELLS) - 1)) << 2);
+		uint32_t below = ((sw >> j) & 3) | (((se >> j) & ((1u << LUT_CELLS) - 1)) << 2);
+		next |= (uint64_t)lut[above | (here << LUT_WIDTH) | (below << (2 * LUT_WIDTH))] << j;
+	}
+	return next;
+}
+
+DEFINE_WORD_STORE(store_lut, word_lut)
+DEFINE_SWAR_KERNEL(row_lut, store_lut)
+
+/**
+ * Defines a SIMD row kernel processing a segment of lanes words per
+ * iteration. The west/east shifts are done lane-wise with the carry bit
+ * taken from an unaligned load one word to the left/right, so only the
+ * first word and the tail of the row (which need the wraparound) go through
+ * the scalar path.
+ *
+ * The changes are accumulated per tile and only reduced to a flag when the
+ * vectors move on to the next tile; a vector straddling two tiles counts
+ * for both.
+ *
+ * @param name Name of the row kernel to define.
+ * @param T Vector type of lanes 64-bit words.
+ * @param lanes Number of words per vector.
+ * @param word Word function of the rule for T.
+ * @param store Store function of the same rule, for the scalar path.
+ * @param ... Extra attributes for the function (e.g. a target ISA).
+ */
+#define DEFINE_ROW_KERNEL(name, T, lanes, word, store, ...) \
+__VA_ARGS__ static inline uint8_t name##_any(T v) { \
+	uint64_t words[lanes]; \
+	memcpy(words, &v, sizeof(T)); \
+	uint64_t any = 0; \
+	for (int lane = 0; lane < (lanes); lane++) { \
+		any |= words[lane]; \
+	} \
+	return any != 0; \
+} \
+\
+__VA_ARGS__ static void name(const uint64_t *above, const uint64_t *here, \
+								const uint64_t *below, uint64_t *out, \
+								uint8_t *changed, int first_tile, int last_tile, \
+								int last_word, int last_bit) { \
+	int i = first_tile * BITWORLD_TILE_WORDS; \
+	int last = ((last_tile + 1) * BITWORLD_TILE_WORDS - 1 < last_word) \
+				? (last_tile + 1) * BITWORLD_TILE_WORDS - 1 : last_word; \
+	memset(changed + first_tile, 0, last_tile - first_tile + 1); \
+	if (i == 0) { \
+		changed[0] = (store(above, here, below, out, 0, last_word, last_bit) != 0); \
+		i++; \
+	} \
+	int tile = i / BITWORLD_TILE_WORDS; \
+	int boundary = (tile + 1) * BITWORLD_TILE_WORDS; \
+	T diffs = {0}; \
+	for (; i + (lanes) <= last + 1 && i + (lanes) <= last_word; i += (lanes)) { \
+		T n, nw, ne, c, w, e, s, sw, se; \
+		memcpy(&n, above + i, sizeof(T)); \
+		memcpy(&nw, above + i - 1, sizeof(T)); \
+		memcpy(&ne, above + i + 1, sizeof(T)); \
+		memcpy(&c, here + i, sizeof(T)); \
+		memcpy(&w, here + i - 1, sizeof(T)); \
+		memcpy(&e, here + i + 1, sizeof(T)); \
+		memcpy(&s, below + i, sizeof(T)); \
+		memcpy(&sw, below + i - 1, sizeof(T)); \
+		memcpy(&se, below + i + 1, sizeof(T)); \
+		T next = word((n << 1) | (nw >> 63), n, (n >> 1) | (ne << 63), \
+						(c << 1) | (w >> 63), c, (c >> 1) | (e << 63), \
+						(s << 1) | (sw >> 63), s, (s >> 1) | (se << 63)); \
+		memcpy(out + i, &next, sizeof(T)); \
+		T diff = next ^ c; \
+		diffs |= diff; \
+		if (i + (lanes) >= boundary) { \
+			/* this vector reaches the end of the tile */ \
+			changed[tile++] |= name##_any(diffs); \
+			diffs = (i + (lanes) > boundary) ? diff : (T){0}; \
+			boundary += BITWORLD_TILE_WORDS; \
+		} \
+	} \
+	if (tile <= last_tile) { \
+		changed[tile] |= name##_any(diffs); \
+	} \
+	for (; i <= last; i++) { \
+		changed[i / BITWORLD_TILE_WORDS] |= \
+			(store(above, here, below, out, i, last_word, last_bit) != 0); \
+	} \
+}
+
+/**
+ * Defines the word functions and row kernels of every rule for one vector
+ * width: row_<isa>_life, row_<isa>_highlife and so on, and row_<isa>_rule
+ * for any other rule.
+ *
+ * @param isa Name of the instruction set, as in the kernel names.
+ * @param T Vector type of lanes 64-bit words.
+ * @param lanes Number of words per vector.
+ * @param ... Extra attributes for the functions (e.g. a target ISA).
+ */
+#define DEFINE_RULE_KERNELS(isa, T, lanes, ...) \
+DEFINE_LIFE_WORD(isa##_life, T, __VA_ARGS__) \
+DEFINE_RULE_WORD(isa##_highlife, T, HIGHLIFE_BIRTH, HIGHLIFE_SURVIVE, __VA_ARGS__) \
+DEFINE_RULE_WORD(isa##_daynight, T, DAYNIGHT_BIRTH, DAYNIGHT_SURVIVE, __VA_ARGS__) \
+DEFINE_RULE_WORD(isa##_seeds, T, SEEDS_BIRTH, SEEDS_SURVIVE, __VA_ARGS__) \
+DEFINE_RULE_WORD(isa##_rule, T, rule_birth, rule_survive, __VA_ARGS__) \
+DEFINE_ROW_KERNEL(row_##isa##_life, T, lanes, isa##_life, store_life, __VA_ARGS__) \
+DEFINE_ROW_KERNEL(row_##isa##_highlife, T, lanes, isa##_highlife, store_highlife, __VA_ARGS__) \
+DEFINE_ROW_KERNEL(row_##isa##_daynight, T, lanes, isa##_daynight, store_daynight, __VA_ARGS__) \
+DEFINE_ROW_KERNEL(row_##isa##_seeds, T, lanes, isa##_seeds, store_seeds, __VA_ARGS__) \
+DEFINE_ROW_KERNEL(row_##isa##_rule, T, lanes, isa##_rule, store_rule, __VA_ARGS__)
+
+#ifdef BITWORLD_X86
+DEFINE_RULE_KERNELS(sse2, u64x2, 2, __attribute__((target("sse2"))))
+DEFINE_RULE_KERNELS(avx2, u64x4, 4, __attribute__((target("avx2"))))
+DEFINE_RULE_KERNELS(avx512, u64x8, 8, __attribute__((target("avx512f"))))
+#endif
+
+// rules with kernels of their own, in the order of the kernels in each
+// entry of kernels; any other rule runs through the last kernel of the
+// entry, which reads rule_birth and rule_survive
+static const Rule compiled_rules[] = {
+	RULE_LIFE,
+	{HIGHLIFE_BIRTH, HIGHLIFE_SURVIVE},
+	{DAYNIGHT_BIRTH, DAYNIGHT_SURVIVE},
+	{SEEDS_BIRTH, SEEDS_SURVIVE},
+};
+
+#define NUM_COMPILED_RULES (int)(sizeof(compiled_rules) / sizeof(compiled_rules[0]))
+
+// the row kernels of one width, for each compiled rule and then any rule
+#define RULE_KERNELS(isa) \
+	{row_##isa##_life, row_##isa##_highlife, row_##isa##_daynight, row_##isa##_seeds, row_##isa##_rule}
+
+// available row kernels, slowest first; the lookup table kernel handles
+// every rule the same way
+static const struct {
+	const char *name;
+	row_kernel fn[NUM_COMPILED_RULES + 1];
+} kernels[] = {
+	{"lut", {row_lut, row_lut, row_lut, row_lut, row_lut}},
+	{"swar", RULE_KERNELS(swar)},
+#ifdef BITWORLD_X86
+	{"sse2", RULE_KERNELS(sse2)},
+	{"avx2", RULE_KERNELS(avx2)},
+	{"avx512", RULE_KERNELS(avx512)},
+#endif
+};
+
+static const int num_kernels = sizeof(kernels) / sizeof(kernels[0]);
+
+// kernel used by bitworld_update (index into kernels), swar until one is
+// selected
+static int selected_kernel = 1;
+
+// rule used by bitworld_update (index into the fn of each kernel)
+static int selected_rule = 0;
+
+/**
+ * Returns true if the CPU we are running on can execute the given kernel.
+ *
+ * @param k Index into kernels.
+ */
+static bool kernel_supported(int k) {
+#ifdef BITWORLD_X86
+	__builtin_cpu_init();
+	if (kernels[k].fn[0] == row_sse2_life) {
+		return __builtin_cpu_supports("sse2");
+	}
+	if (kernels[k].fn[0] == row_avx2_life) {
+		return __builtin_cpu_supports("avx2");
+	}
+	if (kernels[k].fn[0] == row_avx512_life) {
+		return __builtin_cpu_supports("avx512f");
+	}
+#endif
+	(void)k;
+	return true;
+}
+
+int bitworld_select_kernel(const char *name) {
+	// "bit" picked the bit-packed world before there was a choice of kernels
+	if (strcmp(name, "auto") == 0 || strcmp(name, "bit") == 0) {
+		for (int k = num_kernels - 1; k >= 0; k--) {
+			if (kernel_supported(k)) {
+				selected_kernel = k;
+				return 0;
+			}
+		}
+	}
+
+	for (int k = 0; k < num_kernels; k++) {
+		if (strcmp(name, kernels[k].name) == 0 && kernel_supported(k)) {
+			selected_kernel = k;
+			if (kernels[k].fn[0] == row_lut) {
+				build_lut();
+			}
+			return 0;
+		}
+	}
+
+	return -1;
+}
+
+const char *bitworld_kernel_name(void) {
+	return kernels[selected_kernel].name;
+}
+
+void bitworld_set_rule(const Rule *rule) {
+	rule_birth = rule->birth;
+	rule_survive = rule->survive;
+	selected_rule = NUM_COMPILED_RULES;
+	for (int r = 0; r < NUM_COMPILED_RULES; r++) {
+		if (rule_equal(rule, &compiled_rules[r])) {
+			selected_rule = r;
+		}
+	}
+	if (kernels[selected_kernel].fn[0] == row_lut) {
+		build_lut();
+	}
+}
+
+/**
+ * Returns true if a tile or any of the eight tiles around it changed,
+ * wrapping around the ends of the row.
+ *
+ * @param above,here,below Change flags of the tile's row and its neighbors.
+ * @param t Index of the tile within the row.
+ * @param last_tile Index of the last tile in the row.
+ */
+static inline bool tile_active(const uint8_t *above, const uint8_t *here,
+								const uint8_t *below, int t, int last_tile) {
+	int w = (t > 0) ? t - 1 : last_tile;
+	int e = (t < last_tile) ? t + 1 : 0;
+	return above[w] | above[t] | above[e]
+		| here[w] | here[t] | here[e]
+		| below[w] | below[t] | below[e];
+}
+
+void bitworld_update(const BitWorld *curr, BitWorld *next, int start_row, int end_row) {
+	int num_rows = curr->num_rows;
+	int last_word = curr->words_per_row - 1;
+	int last_bit = (curr->num_cols - 1) & 63;
+	int last_tile = curr->tiles_per_row - 1;
+	row_kernel update_row = kernels[selected_kernel].fn[selected_rule];
+
+	for (int y = start_row; y <= end_row; y++) {
+		int y_above = (y == 0) ? num_rows - 1 : y - 1;
+		int y_below = (y == num_rows - 1) ? 0 : y + 1;
+		const uint64_t *above = bitworld_row(curr, y_above);
+		const uint64_t *here = bitworld_row(curr, y);
+		const uint64_t *below = bitworld_row(curr, y_below);
+		const uint8_t *changed_above = bitworld_changed_row(curr, y_above);
+		const uint8_t *changed_here = bitworld_changed_row(curr, y);
+		const uint8_t *changed_below = bitworld_changed_row(curr, y_below);
+		uint64_t *out = bitworld_row(next, y);
+		uint8_t *changed_out = bitworld_changed_row(next, y);
+
+		int t = 0;
+		while (t <= last_tile) {
+			// a quiet tile already holds its cells in next (the generation
+			// before curr), and those are also its cells after curr
+			if (!tile_active(changed_above, changed_here, changed_below, t, last_tile)) {
+				changed_out[t++] = 0;
+				continue;
+			}
+
+			// compute the whole run of active tiles with one kernel call
+			int first_tile = t;
+			while (t < last_tile
+					&& tile_active(changed_above, changed_here, changed_below, t + 1, last_tile)) {
+				t++;
+			}
+			update_row(above, here, below, out, changed_out, first_tile, t, last_word, last_bit);
+			t++;
+		}
+	}
+}
+
+/**
+ * Returns the row index y wrapped around the world, for rows up to any
+ * number of heights away.
+ */
+static inline int wrap_row(int y, int num_rows) {
+	if (y >= 0 && y < num_rows) {
+		return y;
+	}
+	return ((y % num_rows) + num_rows) % num_rows;
+}
+
+/**
+ * Finds the tiles of row y that no change in curr can reach within radius
+ * generations: those with no changed tile within radius rows and one tile
+ * of them.
+ *
+ * @param curr The world whose change flags to read.
+ * @param y The row (may be outside the world; it wraps around).
+ * @param radius Number of rows to look up and down.
+ * @param seen Scratch space for one row of flags.
+ * @param quiet Location where to store the flags of the quiet tiles.
+ */
+static void find_quiet_tiles(const BitWorld *curr, int y, int radius, uint8_t *seen, uint8_t *quiet) {
+	int last_tile = curr->tiles_per_row - 1;
+	memset(seen, 0, last_tile + 1);
+	for (int dy = -radius; dy <= radius; dy++) {
+		const uint8_t *changed = bitworld_changed_row(curr, wrap_row(y + dy, curr->num_rows));
+		for (int t = 0; t <= last_tile; t++) {
+			seen[t] |= changed[t];
+		}
+	}
+	for (int t = 0; t <= last_tile; t++) {
+		int w = (t > 0) ? t - 1 : last_tile;
+		int e = (t < last_tile) ? t + 1 : 0;
+		quiet[t] = !(seen[w] | seen[t] | seen[e]);
+	}
+}
+
+size_t bitworld_block_scratch_size(int num_cols, int num_rows, int generations) {
+	size_t words = (num_cols + 63) / 64;
+	size_t tiles = (words + BITWORLD_TILE_WORDS - 1) / BITWORLD_TILE_WORDS;
+	// the window, then the quiet flags of every row taking part, the change
+	// flags of one row and the scratch row of find_quiet_tiles
+	return 3 * (size_t)(generations - 1) * words * sizeof(uint64_t)
+			+ (num_rows + 2 * (size_t)generations) * tiles + 2 * tiles;
+}
+
+void bitworld_update_block(const BitWorld *curr, BitWorld *next, int start_row, int end_row,
+		int generations, void *scratch) {
+	if (generations == 1) {
+		bitworld_update(curr, next, start_row, end_row);
+		return;
+	}
+
+	int num_rows = curr->num_rows;
+	int words = curr->words_per_row;
+	int last_word = words - 1;
+	int last_bit = (curr->num_cols - 1) & 63;
+	int last_tile = curr->tiles_per_row - 1;
+	// rows start_row - generations through end_row + generations take part
+	int first_row = start_row - generations;
+	int span = end_row - start_row + 1 + 2 * generations;
+	row_kernel update_row = kernels[selected_kernel].fn[selected_rule];
+
+	// the window of three rows of each generation in between, the quiet
+	// tiles of every row taking part, and the change flags of one row
+	uint64_t *window = scratch;
+	uint8_t *quiet = (uint8_t *)(window + (size_t)3 * (generations - 1) * words);
+	uint8_t *flags = quiet + (size_t)span * (last_tile + 1);
+	uint8_t *seen = flags + last_tile + 1;
+	// a row d rows outside the band is only computed for generations - d
+	// generations, so changes further away than that cannot reach it in
+	// time. Looking no further keeps the flags read within generations rows
+	// of the band, in the tiles next to it, which are not being written
+	for (int q = 1; q < span - 1; q++) {
+		int y = first_row + q;
+		int distance = (y < start_row) ? start_row - y : (y > end_row) ? y - end_row : 0;
+		find_quiet_tiles(curr, y, generations - distance, seen,
+				quiet + (size_t)q * (last_tile + 1));
+	}
+
+	// step i computes row i of generation 1, row i - 1 of generation 2,
+	// and so on, each from the rows of the generation before it that are
+	// complete by then
+	for (int i = first_row + 1; i < end_row + generations; i++) {
+		for (int g = 1; g <= generations; g++) {
+			int y = i - g + 1;
+			if (y < first_row + g) {
+				// generation g does not reach this high yet
+				break;
+			}
+
+			const uint64_t *above, *here, *below;
+			if (g == 1) {
+				above = bitworld_row(curr, wrap_row(y - 1, num_rows));
+				here = bitworld_row(curr, wrap_row(y, num_rows));
+				below = bitworld_row(curr, wrap_row(y + 1, num_rows));
+			}
+			else {
+				uint64_t *prev = window + (size_t)3 * (g - 2) * words;
+				above = prev + (size_t)wrap_row(y - 1, 3) * words;
+				here = prev + (size_t)wrap_row(y, 3) * words;
+				below = prev + (size_t)wrap_row(y + 1, 3) * words;
+			}
+			uint64_t *out = (g == generations)
+				? bitworld_row(next, y)
+				: window + ((size_t)3 * (g - 1) + wrap_row(y, 3)) * words;
+			const uint64_t *orig = bitworld_row(curr, wrap_row(y, num_rows));
+			const uint8_t *quiet_here = quiet + (size_t)(y - first_row) * (last_tile + 1);
+			// the rows of the band record their changes in every generation
+			bool in_band = (y >= start_row && y <= end_row);
+			uint8_t *changed_out = in_band ? bitworld_changed_row(next, y) : NULL;
+
+			int t = 0;
+			while (t <= last_tile) {
+				// a quiet tile keeps its cells of curr for all the
+				// generations, and next already holds them
+				if (quiet_here[t]) {
+					if (g < generations) {
+						int i0 = t * BITWORLD_TILE_WORDS;
+						int n = (i0 + BITWORLD_TILE_WORDS <= words) ? BITWORLD_TILE_WORDS : words - i0;
+						memcpy(out + i0, orig + i0, n * sizeof(uint64_t));
+					}
+					if (in_band && g == 1) {
+						changed_out[t] = 0;
+					}
+					t++;
+					continue;
+				}
+
+				int first_tile = t;
+				while (t < last_tile && !quiet_here[t + 1]) {
+					t++;
+				}
+				update_row(above, here, below, out, flags, first_tile, t, last_word, last_bit);
+				if (in_band) {
+					for (int f = first_tile; f <= t; f++) {
+						changed_out[f] = (g == 1) ? flags[f] : (changed_out[f] | flags[f]);
+					}
+				}
+				t++;
+			}
+		}
+	}
+}
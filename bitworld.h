@@ -0,0 +1,235 @@
+#ifndef __BITWORLD_H__
+#define __BITWORLD_H__
+/**
+ * File: bitworld.h
+ *
+ * Bit-packed representation of the game of life world: one bit per cell,
+ * 64 cells per 64-bit word. Each row starts on a word boundary and any
+ * padding bits past the last column are always kept at 0.
+ *
+ * Each row is also split into tiles of BITWORLD_TILE_WORDS words, with a
+ * flag per tile recording whether the last update changed it. A tile whose
+ * neighborhood did not change cannot change either, so bitworld_update
+ * skips it and the cost of a generation follows the activity of the world
+ * rather than its area.
+ */
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "rule.h"
+
+// words per tile of the change tracker; at least the 8 words of the widest
+// SIMD kernel
+#define BITWORLD_TILE_WORDS 32
+
+typedef struct BitWorld {
+	int num_cols;
+	int num_rows;
+	int words_per_row;
+	int tiles_per_row;
+	uint64_t *cells;
+	uint8_t *changed;	// per tile: did the update that wrote this world
+						// change it from the world it was computed from?
+	void *mapping;	// if not NULL, the file mapping cells lies in, which
+					// bitworld_free unmaps instead of freeing cells
+	size_t mapping_size;	// size of mapping in bytes
+} BitWorld;
+
+/**
+ * Creates an empty (all dead) bit-packed world.
+ *
+ * @param num_cols The width of the world.
+ * @param num_rows The height of the world.
+ *
+ * @return The new world, or NULL if it could not be allocated.
+ */
+BitWorld *bitworld_create(int num_cols, int num_rows);
+
+/**
+ * Creates a world whose cells are already in memory mapped from a file, laid
+ * out like the cells of any other world. The mapping becomes part of the
+ * world, so it should be private if the world is going to be updated.
+ *
+ * @param num_cols The width of the world.
+ * @param num_rows The height of the world.
+ * @param mapping The start of the mapping.
+ * @param mapping_size The size of the mapping in bytes.
+ * @param cells_offset The offset of the first row in the mapping; a
+ *   multiple of 64 so the rows are as aligned as the SIMD kernels like.
+ *
+ * @return The new world, or NULL if it could not be allocated (the mapping
+ *   is then left alone).
+ */
+BitWorld *bitworld_from_mapping(int num_cols, int num_rows, void *mapping, size_t mapping_size,
+		size_t cells_offset);
+
+/**
+ * Creates a bit-packed copy of a world returned by initialize_world.
+ *
+ * @param world The int-per-cell world to pack.
+ * @param num_cols The width of the world.
+ * @param num_rows The height of the world.
+ *
+ * @return The new world, or NULL if it could not be allocated.
+ */
+BitWorld *bitworld_from_cells(int *world, int num_cols, int num_rows);
+
+/**
+ * Unpacks a bit-packed world into an int-per-cell world of the same size.
+ *
+ * @param bw The world to unpack.
+ * @param world Location where to store the unpacked cells.
+ */
+void bitworld_to_cells(const BitWorld *bw, int *world);
+
+/**
+ * Copies all cells of src into dst, which must have the same dimensions.
+ * Every tile of dst is marked as changed.
+ *
+ * @param dst The world to overwrite.
+ * @param src The world to copy.
+ */
+void bitworld_copy(BitWorld *dst, const BitWorld *src);
+
+/**
+ * Marks every tile as changed, so the next bitworld_update reading this
+ * world computes all of it. Must be called before updating into a world
+ * other than the one this world was last computed from (or into).
+ *
+ * @param bw The world to mark.
+ */
+void bitworld_mark_all_changed(BitWorld *bw);
+
+/**
+ * Frees a world created by bitworld_create, bitworld_from_cells or
+ * bitworld_from_mapping.
+ *
+ * @param bw The world to free.
+ */
+void bitworld_free(BitWorld *bw);
+
+/**
+ * Returns a pointer to the first word of the given row.
+ */
+static inline uint64_t *bitworld_row(const BitWorld *bw, int row) {
+	return bw->cells + (long)row * bw->words_per_row;
+}
+
+/**
+ * Returns 1 if the cell at (col, row) is alive, 0 otherwise.
+ */
+static inline int bitworld_get(const BitWorld *bw, int col, int row) {
+	return (bitworld_row(bw, row)[col >> 6] >> (col & 63)) & 1;
+}
+
+/**
+ * Returns the number of live cells in a block of the world, counting a word
+ * (64 cells of a row) at a time.
+ *
+ * @param bw The world to count in.
+ * @param col The column of the block's top-left cell.
+ * @param row The row of the block's top-left cell.
+ * @param num_cols The width of the block (at least 1).
+ * @param num_rows The height of the block.
+ */
+int64_t bitworld_count(const BitWorld *bw, int col, int row, int num_cols, int num_rows);
+
+/**
+ * Returns a pointer to the change flag of the first tile of the given row.
+ */
+static inline uint8_t *bitworld_changed_row(const BitWorld *bw, int row) {
+	return bw->changed + (long)row * bw->tiles_per_row;
+}
+
+/**
+ * Sets the cell at (col, row) to alive (1) or dead (0), marking its tile as
+ * changed.
+ */
+static inline void bitworld_set(BitWorld *bw, int col, int row, int alive) {
+	uint64_t *word = &bitworld_row(bw, row)[col >> 6];
+	uint64_t bit = (uint64_t)1 << (col & 63);
+	*word = alive ? (*word | bit) : (*word & ~bit);
+	bitworld_changed_row(bw, row)[(col >> 6) / BITWORLD_TILE_WORDS] = 1;
+}
+
+/**
+ * Selects the kernel used by bitworld_update. All kernels produce identical
+ * results; they differ in how many words they process per instruction.
+ * Should be called before any thread starts updating.
+ *
+ * @param name "auto" (or "bit") for the widest kernel this CPU supports, or one of
+ *    "lut" (portable, looks up 4 cells at a time in a table of the rule,
+ *    never picked by "auto"), "swar" (portable, 64 cells at a time), "sse2",
+ *    "avx2" or "avx512".
+ *
+ * @return 0 on success, -1 if the kernel is unknown or this CPU cannot run it.
+ */
+int bitworld_select_kernel(const char *name);
+
+/**
+ * Returns the name of the kernel currently used by bitworld_update.
+ */
+const char *bitworld_kernel_name(void);
+
+/**
+ * Sets the rule bitworld_update and bitworld_update_block simulate, Life by
+ * default. Life, HighLife (B36/S23), Day & Night (B3678/S34678) and Seeds
+ * (B2/S) have kernels of their own, with the rule's neighbor counts built
+ * into the bit-sliced logic; other rules are matched against every count
+ * they have a transition for. Should be called before any thread starts
+ * updating.
+ *
+ * @param rule The rule to simulate.
+ */
+void bitworld_set_rule(const Rule *rule);
+
+/**
+ * Computes one generation for rows start_row through end_row (inclusive),
+ * 64 cells at a time, along with the change flags of those rows. Tiles
+ * whose neighborhood did not change in curr are skipped: next must be the
+ * world curr was computed from, so those tiles already hold their cells.
+ *
+ * @param curr World for the current turn (read-only).
+ * @param next World for the next turn, same dimensions as curr.
+ * @param start_row First row to compute.
+ * @param end_row Last row to compute.
+ */
+void bitworld_update(const BitWorld *curr, BitWorld *next, int start_row, int end_row);
+
+/**
+ * Computes the given number of generations for rows start_row through
+ * end_row in one pass, so the rows are read from and written to memory once
+ * instead of once per generation. The generations in between are kept in a
+ * window of three rows per generation, which moves down the band with each
+ * generation one row behind the one before it. The rows generations above
+ * and below the band are computed too (and thrown away) since the band
+ * depends on them.
+ *
+ * The change flags of the rows record whether a tile changed in any of the
+ * generations, and as in bitworld_update, tiles whose neighborhood (here,
+ * generations rows and one tile around them) did not change in curr are
+ * skipped: next must be the world curr was computed from.
+ *
+ * @param curr World for the current turn (read-only).
+ * @param next World for the last generation, same dimensions as curr.
+ * @param start_row First row to compute.
+ * @param end_row Last row to compute.
+ * @param generations Number of generations to compute, at most 64.
+ * @param scratch Space for the window and the tile flags, of at least
+ *   bitworld_block_scratch_size bytes, which no other thread is using.
+ */
+void bitworld_update_block(const BitWorld *curr, BitWorld *next, int start_row, int end_row,
+		int generations, void *scratch);
+
+/**
+ * Returns the bytes of scratch space bitworld_update_block needs to compute
+ * up to the given number of generations of up to num_rows rows.
+ *
+ * @param num_cols The width of the world.
+ * @param num_rows The most rows to compute at once.
+ * @param generations The most generations to compute at once.
+ */
+size_t bitworld_block_scratch_size(int num_cols, int num_rows, int generations);
+
+#endif
@@ -0,0 +1,179 @@
+/**
+ * File: byteworld.c
+ *
+ * Implementation of the byte-per-cell world.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "byteworld.h"
+
+// the neighbor counts the rule does anything for, as totals of the 3x3
+// block around a cell (the cell included), and for each one what it does:
+// bit 0 is set if a dead cell with that total is born, bit 1 if a live one
+// survives (with one neighbor less than the total)
+static uint8_t rule_totals[10] = {3, 4};
+static uint8_t rule_actions[10] = {3, 2};
+static int num_rule_totals = 2;
+
+void byteworld_set_rule(const Rule *rule) {
+	num_rule_totals = 0;
+	for (int total = 0; total <= 9; total++) {
+		uint8_t action = ((rule->birth >> total) & 1)
+				| ((total > 0 && ((rule->survive >> (total - 1)) & 1)) << 1);
+		if (action != 0) {
+			rule_totals[num_rule_totals] = total;
+			rule_actions[num_rule_totals] = action;
+			num_rule_totals++;
+		}
+	}
+}
+
+ByteWorld *byteworld_create(int num_cols, int num_rows) {
+	ByteWorld *bw = malloc(sizeof(ByteWorld));
+	if (bw == NULL) {
+		return NULL;
+	}
+
+	bw->num_cols = num_cols;
+	bw->num_rows = num_rows;
+	bw->stride = (num_cols + BYTEWORLD_CHUNK - 1) / BYTEWORLD_CHUNK * BYTEWORLD_CHUNK + 2;
+	bw->cells = calloc((size_t)(num_rows + 2) * bw->stride, 1);
+	if (bw->cells == NULL) {
+		free(bw);
+		return NULL;
+	}
+
+	return bw;
+}
+
+void byteworld_free(ByteWorld *bw) {
+	if (bw == NULL) {
+		return;
+	}
+	free(bw->cells);
+	free(bw);
+}
+
+void byteworld_set(ByteWorld *bw, int col, int row, int alive) {
+	// columns/rows (-1 to num_cols/num_rows) holding this cell: itself, plus
+	// the opposite halo column/row if it is on an edge
+	int cols[3] = {col}, rows[3] = {row};
+	int num_cols = 1, num_rows = 1;
+
+	if (col == 0) {
+		cols[num_cols++] = bw->num_cols;
+	}
+	if (col == bw->num_cols - 1) {
+		cols[num_cols++] = -1;
+	}
+	if (row == 0) {
+		rows[num_rows++] = bw->num_rows;
+	}
+	if (row == bw->num_rows - 1) {
+		rows[num_rows++] = -1;
+	}
+
+	for (int r = 0; r < num_rows; r++) {
+		for (int c = 0; c < num_cols; c++) {
+			byteworld_row(bw, rows[r])[cols[c]] = alive;
+		}
+	}
+}
+
+int64_t byteworld_count(const ByteWorld *bw, int col, int row, int num_cols, int num_rows) {
+	int64_t count = 0;
+	for (int y = row; y < row + num_rows; y++) {
+		const uint8_t *cells = byteworld_row(bw, y) + col;
+		for (int x = 0; x < num_cols; x++) {
+			count += cells[x];
+		}
+	}
+	return count;
+}
+
+/**
+ * Refreshes the halo cells that mirror rows start_row through end_row, like
+ * update_halo does for the int world.
+ */
+static void update_halo_rows(ByteWorld *bw, int start_row, int end_row) {
+	for (int y = start_row; y <= end_row; y++) {
+		uint8_t *row = byteworld_row(bw, y);
+		row[-1] = row[bw->num_cols - 1];
+		row[bw->num_cols] = row[0];
+	}
+
+	// the top/bottom halo rows, including the corners
+	if (start_row == 0) {
+		memcpy(byteworld_row(bw, bw->num_rows) - 1, byteworld_row(bw, 0) - 1, bw->stride);
+	}
+	if (end_row == bw->num_rows - 1) {
+		memcpy(byteworld_row(bw, -1) - 1, byteworld_row(bw, bw->num_rows - 1) - 1, bw->stride);
+	}
+}
+
+void byteworld_copy_rows(ByteWorld *dst, const ByteWorld *src, int start_row, int end_row) {
+	memcpy(byteworld_row(dst, start_row) - 1, byteworld_row(src, start_row) - 1,
+			(size_t)(end_row - start_row + 1) * src->stride);
+	update_halo_rows(dst, start_row, end_row);
+}
+
+/**
+ * Computes the next state of BYTEWORLD_CHUNK cells of a row. Every loop has
+ * a fixed number of iterations and the arrays cannot overlap, so GCC turns
+ * each of them into a few vector instructions.
+ *
+ * @param above The cells above the first cell of the chunk.
+ * @param here The first cell of the chunk.
+ * @param below The cells below the first cell of the chunk.
+ * @param next Where to store the next state of the chunk.
+ */
+static inline void update_chunk(const uint8_t *restrict above, const uint8_t *restrict here,
+		const uint8_t *restrict below, uint8_t *restrict next) {
+	// column[i + 1]: the live cells of column i of the chunk and the cells
+	// above and below it, for columns -1 to BYTEWORLD_CHUNK
+	uint8_t column[BYTEWORLD_CHUNK + 2];
+	uint8_t total[BYTEWORLD_CHUNK];
+	uint8_t action[BYTEWORLD_CHUNK];
+
+	column[0] = above[-1] + here[-1] + below[-1];
+	for (int i = 0; i < BYTEWORLD_CHUNK; i++) {
+		column[i + 1] = above[i] + here[i] + below[i];
+	}
+	column[BYTEWORLD_CHUNK + 1] = above[BYTEWORLD_CHUNK] + here[BYTEWORLD_CHUNK]
+			+ below[BYTEWORLD_CHUNK];
+
+	for (int i = 0; i < BYTEWORLD_CHUNK; i++) {
+		total[i] = column[i] + column[i + 1] + column[i + 2];
+		action[i] = 0;
+	}
+
+	for (int t = 0; t < num_rule_totals; t++) {
+		uint8_t match = rule_totals[t], act = rule_actions[t];
+		for (int i = 0; i < BYTEWORLD_CHUNK; i++) {
+			action[i] |= (total[i] == match) ? act : 0;
+		}
+	}
+
+	// bit 0 of the action is what happens to a dead cell, bit 1 to a live one
+	for (int i = 0; i < BYTEWORLD_CHUNK; i++) {
+		next[i] = (action[i] & (here[i] + 1)) != 0;
+	}
+}
+
+void byteworld_update(const ByteWorld *curr, ByteWorld *next, int start_row, int end_row) {
+	for (int y = start_row; y <= end_row; y++) {
+		const uint8_t *above = byteworld_row(curr, y - 1);
+		const uint8_t *here = byteworld_row(curr, y);
+		const uint8_t *below = byteworld_row(curr, y + 1);
+		uint8_t *out = byteworld_row(next, y);
+		// the chunks past the last column only write padding and the right
+		// halo cell, which is refreshed below
+		for (int x = 0; x < curr->num_cols; x += BYTEWORLD_CHUNK) {
+			update_chunk(above + x, here + x, below + x, out + x);
+		}
+	}
+
+	update_halo_rows(next, start_row, end_row);
+}
@@ -0,0 +1,106 @@
+#ifndef __BYTEWORLD_H__
+#define __BYTEWORLD_H__
+/**
+ * File: byteworld.h
+ *
+ * Byte-per-cell representation of the game of life world: the layout of
+ * the int world of gol.h (a one-cell halo mirroring the opposite edges), a
+ * quarter of its size. Every cell is still a byte of its own, so cells can
+ * be read and written in place and could hold more states than alive and
+ * dead, unlike the bit-packed world.
+ *
+ * Rows are padded to a multiple of BYTEWORLD_CHUNK cells, so byteworld_update
+ * can count neighbors a chunk at a time in loops of a fixed length, which
+ * GCC vectorizes at -O2 without knowing the width of the world: the three
+ * rows around a chunk are first summed column by column, then those sums
+ * three by three along the row.
+ */
+
+#include <stdint.h>
+
+#include "rule.h"
+
+// cells per chunk of byteworld_update, and the multiple the row widths are
+// padded to
+#define BYTEWORLD_CHUNK 64
+
+typedef struct ByteWorld {
+	int num_cols;
+	int num_rows;
+	int stride;	// bytes between vertically adjacent cells: num_cols
+				// padded to a multiple of BYTEWORLD_CHUNK, plus the halo
+	uint8_t *cells;
+} ByteWorld;
+
+/**
+ * Creates an empty (all dead) byte-per-cell world.
+ *
+ * @param num_cols The width of the world.
+ * @param num_rows The height of the world.
+ *
+ * @return The new world, or NULL if it could not be allocated.
+ */
+ByteWorld *byteworld_create(int num_cols, int num_rows);
+
+/**
+ * Frees a world created by byteworld_create.
+ *
+ * @param bw The world to free (may be NULL).
+ */
+void byteworld_free(ByteWorld *bw);
+
+/**
+ * Returns a pointer to the cell at column 0 of a row; columns -1 and
+ * num_cols are its halo cells.
+ */
+static inline uint8_t *byteworld_row(const ByteWorld *bw, int row) {
+	return bw->cells + (size_t)(row + 1) * bw->stride + 1;
+}
+
+/**
+ * Returns 1 if the cell at (col, row) is alive, 0 otherwise.
+ */
+static inline int byteworld_get(const ByteWorld *bw, int col, int row) {
+	return byteworld_row(bw, row)[col];
+}
+
+/**
+ * Sets the cell at (col, row) to alive (1) or dead (0), along with the halo
+ * cells that mirror it.
+ */
+void byteworld_set(ByteWorld *bw, int col, int row, int alive);
+
+/**
+ * Returns the number of live cells in the num_cols by num_rows block whose
+ * top-left cell is (col, row).
+ */
+int64_t byteworld_count(const ByteWorld *bw, int col, int row, int num_cols, int num_rows);
+
+/**
+ * Copies rows start_row through end_row of src into dst, a world of the
+ * same size, with the halo cells that mirror them.
+ */
+void byteworld_copy_rows(ByteWorld *dst, const ByteWorld *src, int start_row, int end_row);
+
+/**
+ * Computes rows start_row through end_row of the next generation, based on
+ * the current rule (see byteworld_set_rule), and the halo cells mirroring
+ * them. Rows of next outside that range are not touched.
+ *
+ * @param curr The world for the current turn (read-only).
+ * @param next The world for the next turn, of the same size.
+ * @param start_row First row to update.
+ * @param end_row Last row to update.
+ */
+void byteworld_update(const ByteWorld *curr, ByteWorld *next, int start_row, int end_row);
+
+/**
+ * Sets the rule byteworld_update simulates, Life by default. Any rule costs
+ * about the same: one compare per neighbor count the rule does anything
+ * for. Should be called before any thread starts updating.
+ *
+ * @param rule The rule to simulate.
+ */
+void byteworld_set_rule(const Rule *rule);
+
+#endif
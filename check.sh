@@ -0,0 +1,160 @@
+#!/bin/sh
+#
+# Runs a few patterns whose final worlds are known, then random boards,
+# through every kernel, HashLife, several -b values and several rules,
+# headless, and compares the final worlds they save with -o against the
+# known ones (for random boards, those of the int kernel). Kernels this CPU
+# cannot run are skipped. Also checks the largest worlds that can be loaded.
+#
+# usage: ./check.sh [path to gol]
+
+GOL=${1:-./gol}
+TURNS=12
+SIZES="100x37 700x20 64x64 128x64 1x16"
+RULES="B3/S23 B36/S23 B3678/S34678 B2/S B0/S8 B1/S1 B35678/S5678 B012/S3"
+KERNELS="byte lut swar sse2 avx2 avx512 hashlife"
+BLOCKS="1 2 5"
+
+dir=$(mktemp -d) || exit 1
+trap 'rm -rf "$dir"' EXIT
+
+runs=0
+failures=0
+
+# runs a board through kernels and compares the final worlds with the one
+# in $expected
+# usage: check_kernels <label> <board> <rule> <turns> <kernels>
+check_kernels() {
+	for kernel in $5; do
+		case $kernel in
+			int|byte|hashlife) blocks=1 ;;
+			*) blocks=$BLOCKS ;;
+		esac
+		for b in $blocks; do
+			actual="$dir/actual.rle"
+			rm -f "$actual"
+			"$GOL" -q -c "$2" -t $4 -k $kernel -b $b -p 3 -R "$3" -o "$actual" \
+					> /dev/null 2> "$dir/stderr"
+			status=$?
+			if grep -q "Unknown or unsupported kernel" "$dir/stderr" \
+					|| grep -q "powers of two" "$dir/stderr"; then
+				continue
+			fi
+			runs=$((runs + 1))
+			if [ $status -ne 0 ] || ! cmp -s "$expected" "$actual"; then
+				echo "FAIL: $1 $3 -k $kernel -b $b"
+				failures=$((failures + 1))
+			fi
+		done
+	done
+}
+
+# writes a config file: rows, columns and number of live cells, then the
+# column and row of each of them
+# usage: write_config <cols>x<rows> <col>,<row>;... > file
+write_config() {
+	echo "$2" | tr ';' '\n' | awk -F, -v size="$1" '{
+		cell[n++] = $1 " " $2
+	} END {
+		split(size, dims, "x")
+		print dims[2], dims[1], n
+		for (i = 0; i < n; i++)
+			print cell[i]
+	}'
+}
+
+# patterns whose final worlds are known: the size of the world, the rule,
+# the number of turns, then the live cells at the start and at the end. A
+# blinker flips once and is back after an even number of turns, a glider
+# moves a cell diagonally every 4 turns, wrapping around the corner here
+# (the same in HighLife, where no cell next to it ever has 6 neighbors), and
+# in Seeds a domino dies and leaves two, which grow into a ring of six
+while read -r size rule turns start end; do
+	write_config "$size" "$start" > "$dir/pattern.txt"
+	write_config "$size" "$end" > "$dir/known.txt"
+	expected="$dir/expected.rle"
+	"$GOL" -q -c "$dir/known.txt" -t 0 -k int -R "$rule" -o "$expected" > /dev/null
+	check_kernels "$size pattern" "$dir/pattern.txt" "$rule" "$turns" "int $KERNELS"
+done <<EOF
+16x8 B3/S23 1 7,3;7,4;7,5 6,4;7,4;8,4
+16x8 B3/S23 12 7,3;7,4;7,5 7,3;7,4;7,5
+32x16 B3/S23 12 30,13;31,14;29,15;30,15;31,15 1,0;2,1;0,2;1,2;2,2
+32x16 B36/S23 12 30,13;31,14;29,15;30,15;31,15 1,0;2,1;0,2;1,2;2,2
+16x16 B2/S 1 7,7;8,7 7,6;8,6;7,8;8,8
+16x16 B2/S 2 7,7;8,7 7,5;8,5;6,7;9,7;7,9;8,9
+EOF
+
+seed=1
+for size in $SIZES; do
+	cols=${size%x*}
+	rows=${size#*x}
+	board="$dir/board.txt"
+	# a config file: rows, columns and number of live cells, then the
+	# column and row of each of them
+	awk -v cols="$cols" -v rows="$rows" -v seed="$seed" 'BEGIN {
+		srand(seed)
+		n = 0
+		for (y = 0; y < rows; y++)
+			for (x = 0; x < cols; x++)
+				if (rand() < 0.35)
+					cell[n++] = x " " y
+		print rows, cols, n
+		for (i = 0; i < n; i++)
+			print cell[i]
+	}' > "$board"
+	seed=$((seed + 1))
+
+	for rule in $RULES; do
+		expected="$dir/expected.rle"
+		if ! "$GOL" -q -c "$board" -t $TURNS -k int -p 3 -R "$rule" -o "$expected" > /dev/null; then
+			echo "FAIL: $size $rule int did not run"
+			failures=$((failures + 1))
+			continue
+		fi
+		check_kernels "$size" "$board" "$rule" $TURNS "$KERNELS"
+	done
+
+	# a macrocell file keeps the size of a world (if its sides are powers of
+	# two), even with other comments after it
+	runs=$((runs + 1))
+	"$GOL" -q -c "$board" -t $TURNS -k int -o "$expected" > /dev/null
+	if "$GOL" -q -c "$board" -t 0 -k int -o "$dir/board.mc" > /dev/null 2>&1; then
+		sed '/^#C world/a #C a comment' "$dir/board.mc" > "$dir/commented.mc"
+		rm -f "$dir/actual.rle"
+		"$GOL" -q -c "$dir/commented.mc" -t $TURNS -k int -o "$dir/actual.rle" > /dev/null
+		if ! cmp -s "$expected" "$dir/actual.rle"; then
+			echo "FAIL: $size does not survive a macrocell file"
+			failures=$((failures + 1))
+		fi
+	else
+		runs=$((runs - 1))
+	fi
+done
+
+# the largest int worlds translate_to_1D can index must be accepted and the
+# next size up rejected. Memory is limited, so an accepted world fails to
+# allocate at once instead of being simulated. RLE headers stop at 2^30 rows
+for limit in "65533 65533 ok txt rle" "65534 65534 large txt rle" "1431655763 1 ok txt" \
+		"1431655764 1 large txt"; do
+	set -- $limit
+	printf '%s %s 1\n0 0\n' "$1" "$2" > "$dir/limit.txt"
+	printf 'x = %s, y = %s\no!\n' "$2" "$1" > "$dir/limit.rle"
+	expected=$3
+	shift 3
+	for format in "$@"; do
+		file="$dir/limit.$format"
+		runs=$((runs + 1))
+		if (ulimit -v 1000000; "$GOL" -q -c "$file" -t 0 -k int 2>&1 > /dev/null) | grep -q "too large"; then
+			result=large
+		else
+			result=ok
+		fi
+		if [ $result != "$expected" ]; then
+			echo "FAIL: $limit: the world is $result, expected $expected ($format)"
+			failures=$((failures + 1))
+		fi
+	done
+done
+
+echo "$runs runs, $failures failures"
+[ $failures -eq 0 ]
@@ -0,0 +1,357 @@
+/**
+ * File: checkpoint.c
+ *
+ * Implementation of binary checkpoints: written with plain write calls and
+ * restored with mmap. Checkpoints of a running simulation are written by a
+ * thread of their own.
+ */
+
+#define _XOPEN_SOURCE 600
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <pthread.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "checkpoint.h"
+
+static const char checkpoint_magic[8] = "GOLCKPT";
+
+// multiplier of the checksum, the 64-bit golden ratio
+#define CHECKSUM_PRIME 0x9E3779B97F4A7C15ull
+
+uint64_t checkpoint_checksum(const BitWorld *bw) {
+	// four independent lanes so the multiplies overlap and the sum keeps up
+	// with reading the rows from memory
+	const uint64_t *words = bw->cells;
+	size_t num_words = (size_t)bw->words_per_row * bw->num_rows;
+	uint64_t lanes[4] = {1, 2, 3, 4};
+	size_t i = 0;
+	for (; i + 4 <= num_words; i += 4) {
+		for (int k = 0; k < 4; k++) {
+			uint64_t h = (lanes[k] ^ words[i + k]) * CHECKSUM_PRIME;
+			lanes[k] = h ^ (h >> 29);
+		}
+	}
+	for (; i < num_words; i++) {
+		uint64_t h = (lanes[0] ^ words[i]) * CHECKSUM_PRIME;
+		lanes[0] = h ^ (h >> 29);
+	}
+
+	uint64_t sum = num_words;
+	for (int k = 0; k < 4; k++) {
+		sum = (sum ^ lanes[k]) * CHECKSUM_PRIME;
+		sum ^= sum >> 29;
+	}
+	return sum;
+}
+
+/**
+ * Writes all of a buffer, however many write calls it takes.
+ */
+static int write_all(int fd, const void *buf, size_t size) {
+	const char *p = buf;
+	while (size > 0) {
+		ssize_t written = write(fd, p, size);
+		if (written < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+			return -1;
+		}
+		p += written;
+		size -= written;
+	}
+	return 0;
+}
+
+int checkpoint_write(const char *filename, const BitWorld *bw, uint64_t generation, const char *rule) {
+	CheckpointHeader header;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, checkpoint_magic, sizeof(header.magic));
+	header.version = CHECKPOINT_VERSION;
+	header.header_size = CHECKPOINT_HEADER_SIZE;
+	header.num_cols = bw->num_cols;
+	header.num_rows = bw->num_rows;
+	header.words_per_row = bw->words_per_row;
+	header.generation = generation;
+	header.checksum = checkpoint_checksum(bw);
+	snprintf(header.rule, sizeof(header.rule), "%s", rule);
+
+	size_t name_len = strlen(filename);
+	char *tmp_name = malloc(name_len + 5);
+	if (tmp_name == NULL) {
+		return -1;
+	}
+	snprintf(tmp_name, name_len + 5, "%s.tmp", filename);
+
+	int fd = open(tmp_name, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	if (fd < 0) {
+		free(tmp_name);
+		return -1;
+	}
+
+	char block[CHECKPOINT_HEADER_SIZE];
+	memset(block, 0, sizeof(block));
+	memcpy(block, &header, sizeof(header));
+	int ret = write_all(fd, block, sizeof(block));
+	if (ret == 0) {
+		ret = write_all(fd, bw->cells, (size_t)bw->words_per_row * bw->num_rows * sizeof(uint64_t));
+	}
+	if (ret == 0) {
+		ret = fsync(fd);
+	}
+	if (close(fd) != 0) {
+		ret = -1;
+	}
+	if (ret == 0) {
+		ret = rename(tmp_name, filename);
+	}
+	if (ret != 0) {
+		int saved_errno = errno;
+		unlink(tmp_name);
+		errno = saved_errno;
+	}
+
+	free(tmp_name);
+	return ret;
+}
+
+BitWorld *checkpoint_map(const char *filename, uint64_t *generation, char *rule, size_t rule_size,
+		bool verify) {
+	int fd = open(filename, O_RDONLY);
+	if (fd < 0) {
+		return NULL;
+	}
+
+	struct stat st;
+	if (fstat(fd, &st) != 0 || (size_t)st.st_size < CHECKPOINT_HEADER_SIZE) {
+		close(fd);
+		return NULL;
+	}
+
+	// the mapping stays valid after the file is closed
+	size_t size = st.st_size;
+	void *mapping = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (mapping == MAP_FAILED) {
+		return NULL;
+	}
+
+	const CheckpointHeader *header = mapping;
+	bool valid = memcmp(header->magic, checkpoint_magic, sizeof(header->magic)) == 0
+			&& header->version == CHECKPOINT_VERSION
+			&& header->header_size == CHECKPOINT_HEADER_SIZE
+			&& header->num_cols > 0 && header->num_rows > 0
+			&& header->words_per_row == ((uint64_t)header->num_cols + 63) / 64
+			&& header->words_per_row * header->num_rows * sizeof(uint64_t)
+				== size - CHECKPOINT_HEADER_SIZE;
+	BitWorld *bw = valid ? bitworld_from_mapping(header->num_cols, header->num_rows, mapping,
+			size, CHECKPOINT_HEADER_SIZE) : NULL;
+	if (bw == NULL) {
+		munmap(mapping, size);
+		return NULL;
+	}
+	if (verify && checkpoint_checksum(bw) != header->checksum) {
+		bitworld_free(bw);
+		return NULL;
+	}
+
+	*generation = header->generation;
+	snprintf(rule, rule_size, "%.*s", (int)sizeof(header->rule), header->rule);
+	return bw;
+}
+
+// spare worlds of a Checkpointer: one being written while the simulation
+// fills the other
+#define CHECKPOINTER_BUFFERS 2
+
+enum {
+	BUFFER_FREE,
+	BUFFER_FILLING,	// the simulation is copying a snapshot into it
+	BUFFER_QUEUED,	// holds a complete snapshot, not saved yet
+};
+
+struct Checkpointer {
+	SimSnapshots snapshots;	// arg points back to the Checkpointer
+	char *filename;
+	const Engine *engine;
+	int num_cols;
+	int num_rows;
+	uint64_t first_generation;
+	char rule[64];
+	void *buffers[CHECKPOINTER_BUFFERS];
+	int state[CHECKPOINTER_BUFFERS];
+	int turn[CHECKPOINTER_BUFFERS];	// of the snapshot in each queued buffer
+	BitWorld *packed;	// snapshots of other engines, packed for writing
+	pthread_t thread;
+	pthread_mutex_t lock;
+	pthread_cond_t queued;	// a buffer was queued, or closing was set
+	bool closing;
+	int error;	// errno of the first snapshot that failed to save, or 0
+};
+
+/**
+ * Hands out a free buffer for a snapshot, or NULL if both are busy.
+ */
+static void *checkpointer_acquire(void *arg, int turn, int *first_row, int *last_row) {
+	Checkpointer *cp = arg;
+	void *world = NULL;
+	(void)turn;
+	(void)first_row;
+	(void)last_row;
+
+	pthread_mutex_lock(&cp->lock);
+	for (int i = 0; i < CHECKPOINTER_BUFFERS && world == NULL; i++) {
+		if (cp->state[i] == BUFFER_FREE) {
+			cp->state[i] = BUFFER_FILLING;
+			world = cp->buffers[i];
+		}
+	}
+	pthread_mutex_unlock(&cp->lock);
+	return world;
+}
+
+/**
+ * Queues a complete snapshot for the writer thread.
+ */
+static void checkpointer_release(void *arg, void *world, int turn) {
+	Checkpointer *cp = arg;
+
+	pthread_mutex_lock(&cp->lock);
+	for (int i = 0; i < CHECKPOINTER_BUFFERS; i++) {
+		if (cp->buffers[i] == world) {
+			cp->state[i] = BUFFER_QUEUED;
+			cp->turn[i] = turn;
+		}
+	}
+	pthread_cond_signal(&cp->queued);
+	pthread_mutex_unlock(&cp->lock);
+}
+
+/**
+ * Body of the writer thread: saves queued snapshots, oldest first, until
+ * the Checkpointer is closing and none are left.
+ */
+static void *checkpointer_thread(void *arg) {
+	Checkpointer *cp = arg;
+
+	pthread_mutex_lock(&cp->lock);
+	for (;;) {
+		int next = -1;
+		for (int i = 0; i < CHECKPOINTER_BUFFERS; i++) {
+			if (cp->state[i] == BUFFER_QUEUED && (next < 0 || cp->turn[i] < cp->turn[next])) {
+				next = i;
+			}
+		}
+		if (next < 0) {
+			if (cp->closing) {
+				break;
+			}
+			pthread_cond_wait(&cp->queued, &cp->lock);
+			continue;
+		}
+		pthread_mutex_unlock(&cp->lock);
+
+		const BitWorld *bw = cp->buffers[next];
+		if (cp->packed != NULL) {
+			for (int row = 0; row < cp->num_rows; row++) {
+				for (int col = 0; col < cp->num_cols; col++) {
+					bitworld_set(cp->packed, col, row, cp->engine->get(cp->buffers[next], col, row));
+				}
+			}
+			bw = cp->packed;
+		}
+		int ret = checkpoint_write(cp->filename, bw, cp->first_generation + cp->turn[next], cp->rule);
+		int saved_errno = errno;
+
+		pthread_mutex_lock(&cp->lock);
+		if (ret != 0 && cp->error == 0) {
+			cp->error = saved_errno;
+		}
+		cp->state[next] = BUFFER_FREE;
+	}
+	pthread_mutex_unlock(&cp->lock);
+	return NULL;
+}
+
+Checkpointer *checkpointer_create(const char *filename, const Engine *engine, int num_cols, int num_rows,
+		int every, uint64_t first_generation, const char *rule) {
+	Checkpointer *cp = calloc(1, sizeof(Checkpointer));
+	if (cp == NULL) {
+		return NULL;
+	}
+
+	cp->snapshots.every = every;
+	cp->snapshots.acquire = checkpointer_acquire;
+	cp->snapshots.release = checkpointer_release;
+	cp->snapshots.arg = cp;
+	cp->filename = strdup(filename);
+	cp->engine = engine;
+	cp->num_cols = num_cols;
+	cp->num_rows = num_rows;
+	cp->first_generation = first_generation;
+	snprintf(cp->rule, sizeof(cp->rule), "%s", rule);
+	bool ok = (cp->filename != NULL);
+	for (int i = 0; i < CHECKPOINTER_BUFFERS; i++) {
+		cp->buffers[i] = engine->create(num_cols, num_rows);
+		ok = ok && cp->buffers[i] != NULL;
+	}
+	// bit-packed snapshots are written as they are
+	if (engine != &bit_engine) {
+		cp->packed = bitworld_create(num_cols, num_rows);
+		ok = ok && cp->packed != NULL;
+	}
+	if (!ok) {
+		for (int i = 0; i < CHECKPOINTER_BUFFERS; i++) {
+			if (cp->buffers[i] != NULL) {
+				engine->destroy(cp->buffers[i]);
+			}
+		}
+		bitworld_free(cp->packed);
+		free(cp->filename);
+		free(cp);
+		return NULL;
+	}
+
+	pthread_mutex_init(&cp->lock, NULL);
+	pthread_cond_init(&cp->queued, NULL);
+	if (pthread_create(&cp->thread, NULL, checkpointer_thread, cp) != 0) {
+		perror("pthread_create");
+		exit(EXIT_FAILURE);
+	}
+	return cp;
+}
+
+const SimSnapshots *checkpointer_snapshots(Checkpointer *cp) {
+	return &cp->snapshots;
+}
+
+int checkpointer_free(Checkpointer *cp) {
+	pthread_mutex_lock(&cp->lock);
+	cp->closing = true;
+	pthread_cond_signal(&cp->queued);
+	pthread_mutex_unlock(&cp->lock);
+	pthread_join(cp->thread, NULL);
+
+	int error = cp->error;
+	for (int i = 0; i < CHECKPOINTER_BUFFERS; i++) {
+		cp->engine->destroy(cp->buffers[i]);
+	}
+	bitworld_free(cp->packed);
+	pthread_mutex_destroy(&cp->lock);
+	pthread_cond_destroy(&cp->queued);
+	free(cp->filename);
+	free(cp);
+
+	if (error != 0) {
+		errno = error;
+		return -1;
+	}
+	return 0;
+}
@@ -0,0 +1,126 @@
+#ifndef __CHECKPOINT_H__
+#define __CHECKPOINT_H__
+/**
+ * File: checkpoint.h
+ *
+ * Binary checkpoints of a simulation: a CheckpointHeader followed, at
+ * CHECKPOINT_HEADER_SIZE bytes into the file, by the rows of a bit-packed
+ * world exactly as they are laid out in memory. A checkpoint is restored by
+ * mapping the file and simulating its rows in place, so restoring takes no
+ * parsing and no copying however large the world is.
+ *
+ * Checkpoints use the byte order of the machine that wrote them.
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "bitworld.h"
+#include "sim.h"
+
+// offset of the first row in the file, a whole page so the rows are too
+#define CHECKPOINT_HEADER_SIZE 4096
+
+#define CHECKPOINT_VERSION 1
+
+/**
+ * The header at the start of every checkpoint file.
+ */
+typedef struct CheckpointHeader {
+	char magic[8];	// "GOLCKPT" and a NUL
+	uint32_t version;	// CHECKPOINT_VERSION
+	uint32_t header_size;	// CHECKPOINT_HEADER_SIZE
+	int32_t num_cols;
+	int32_t num_rows;
+	uint64_t words_per_row;
+	uint64_t generation;	// generations simulated to get to this world
+	uint64_t checksum;	// of the rows, see checkpoint_checksum
+	char rule[64];	// NUL-terminated, e.g. "B3/S23"
+} CheckpointHeader;
+
+/**
+ * Returns the checksum of the rows of a world, as stored in the header.
+ *
+ * @param bw The world.
+ */
+uint64_t checkpoint_checksum(const BitWorld *bw);
+
+/**
+ * Writes a checkpoint of a world. The file is written under a temporary
+ * name, flushed to disk and then renamed, so an existing checkpoint is only
+ * replaced by a complete one.
+ *
+ * @param filename The name of the checkpoint file.
+ * @param bw The world to save.
+ * @param generation The generation the world is at.
+ * @param rule The rule the world is simulated with.
+ *
+ * @return 0 on success, -1 (with errno set) if the file could not be
+ *   written.
+ */
+int checkpoint_write(const char *filename, const BitWorld *bw, uint64_t generation, const char *rule);
+
+/**
+ * Restores a checkpoint by mapping it into memory. The mapping is private,
+ * so simulating the world does not change the file.
+ *
+ * @param filename The name of the checkpoint file.
+ * @param generation Location where to store the generation of the world.
+ * @param rule Location where to store the rule of the world, truncated to
+ *   rule_size - 1 characters.
+ * @param rule_size The size of rule.
+ * @param verify Whether to check the rows against the checksum, which
+ *   reads the whole file instead of only the pages the world touches.
+ *
+ * @return The world, or NULL if the file could not be mapped, is not a
+ *   checkpoint or (if verify is set) is corrupt.
+ */
+BitWorld *checkpoint_map(const char *filename, uint64_t *generation, char *rule, size_t rule_size,
+		bool verify);
+
+/**
+ * Saves the periodic snapshots of a running simulation as checkpoints
+ * without holding it up. The simulating threads copy each snapshot into
+ * one of two spare worlds, and a thread of the Checkpointer writes it out
+ * while the simulation goes on. If both spare worlds are still taken when
+ * a snapshot is due, that snapshot is skipped rather than waited for.
+ */
+typedef struct Checkpointer Checkpointer;
+
+/**
+ * Starts a Checkpointer that saves every snapshot to the same file, each
+ * one replacing the one before.
+ *
+ * @param filename The name of the checkpoint file.
+ * @param engine The engine of the simulated world.
+ * @param num_cols The width of the world.
+ * @param num_rows The height of the world.
+ * @param every Generations between snapshots.
+ * @param first_generation The generation the simulation starts at.
+ * @param rule The rule the world is simulated with.
+ *
+ * @return The new Checkpointer, or NULL if it could not be allocated.
+ */
+Checkpointer *checkpointer_create(const char *filename, const Engine *engine, int num_cols, int num_rows,
+		int every, uint64_t first_generation, const char *rule);
+
+/**
+ * Returns the snapshot callbacks to put in the SimOptions of the simulation.
+ *
+ * @param cp The Checkpointer.
+ */
+const SimSnapshots *checkpointer_snapshots(Checkpointer *cp);
+
+/**
+ * Waits for the snapshots handed over so far to be saved, then stops the
+ * Checkpointer and frees it.
+ *
+ * @param cp The Checkpointer to free.
+ *
+ * @return 0 if every snapshot was saved, or -1 (with errno set) if one of
+ *   them could not be written.
+ */
+int checkpointer_free(Checkpointer *cp);
+
+#endif
@@ -10,12 +10,29 @@
 #include <stdio.h>
 #include <unistd.h>
 #include <string.h>
-#include <curses.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <limits.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 
 #include "gol.h"
+#include "rle.h"
+
+// the rule update_world simulates: bit n is set if a dead cell with n live
+// neighbors is born, bit 9 + n if a live one with n live neighbors survives
+static uint32_t transitions = (1 << 3) | (((1 << 2) | (1 << 3)) << 9);
+
+void set_rule(const Rule *rule) {
+	transitions = rule->birth | ((uint32_t)rule->survive << 9);
+}
 
 /**
  * Given 2D coordinates, compute the corresponding index in the 1D array.
+ * The array is padded with a one-cell halo on every side, so row r of the
+ * world starts at (r+1)*(num_cols+2) + 1.
  *
  * @param col The x-coord we are converting
  * @param row The y-coord we are converting
@@ -43,139 +60,361 @@ unsigned int translate_to_1D(int col, int row, unsigned num_cols, unsigned num_r
         row -= num_rows;
     }
 
-	return row*num_cols + col;
+	return (row + 1)*(num_cols + 2) + col + 1;
+}
+
+size_t world_size(int num_cols, int num_rows) {
+	return (size_t)(num_cols + 2)*(num_rows + 2);
+}
+
+bool world_fits(int num_cols, int num_rows) {
+	// each dimension first, so the product cannot overflow
+	if (num_cols < 1 || num_rows < 1 || num_cols > INT_MAX - 2 || num_rows > INT_MAX - 2) {
+		return false;
+	}
+	// translate_to_1D returns the index of an int, not a byte offset
+	return (uint64_t)(num_cols + 2) * (num_rows + 2) <= UINT_MAX;
+}
+
+void update_halo(int *world, int num_cols, int num_rows, int start_row, int end_row) {
+	unsigned stride = num_cols + 2;
+
+	if (start_row > end_row) {
+		return;
+	}
+
+	// the left/right halo columns of each row
+	for (int y = start_row; y <= end_row; y++) {
+		int *row = world + translate_to_1D(0, y, num_cols, num_rows);
+		row[-1] = row[num_cols - 1];
+		row[num_cols] = row[0];
+	}
+
+	// the top/bottom halo rows, including the corners
+	if (start_row == 0) {
+		memcpy(world + (num_rows + 1)*stride, world + stride, stride*sizeof(int));
+	}
+	if (end_row == num_rows - 1) {
+		memcpy(world, world + num_rows*stride, stride*sizeof(int));
+	}
 }
 
 /**
- * Returns the number of neighbors around a given (x,y) point that are alive.
+ * Returns the number of neighbors around a given cell that are alive.
+ * Neighbors of edge cells live in the halo, so every neighbor is at a fixed
+ * offset from the cell.
  *
  * @param world The world we are simulating
- * @param x x-coord whose neighbors we are examining
- * @param y y-coord whose neighbors we are examining
- * @param num_cols The width of the world
- * @param num_rows The height of the world
+ * @param index Index of the cell whose neighbors we are examining
+ * @param stride Distance between vertically adjacent cells (num_cols+2)
  *
- * @return The number of live neighbors around (x,y)
+ * @return The number of live neighbors around the cell
  */
-unsigned int count_live_neighbors(int *world, int x, int y,
-									unsigned num_cols, unsigned num_rows) {
-	unsigned sum = 0;
-
-	for (int col = x-1; col <= x+1; col++) {
-		for (int row = y-1; row <= y+1; row++) {
-			if (col == x && row == y) continue;
-			unsigned index = translate_to_1D(col,row,num_cols,num_rows);
-			if (world[index] == 1) {
-				++sum;
-			}
-		}
-	}
+unsigned int count_live_neighbors(int *world, unsigned index, unsigned stride) {
+	int *above = world + index - stride;
+	int *here = world + index;
+	int *below = world + index + stride;
 
-	return sum;
+	return above[-1] + above[0] + above[1]
+		+ here[-1] + here[1]
+		+ below[-1] + below[0] + below[1];
 }
 
 /**
- * Updates cell at given coordinate.
+ * Updates cell at given coordinate. The cell is always written, so
+ * next_world does not need to start out as a copy of curr_world.
  *
  * @param curr_world World for the current turn (read-only).
  * @param next_world World for the next turn.
- * @param x x-coord whose neighbors we are examining
- * @param y y-coord whose neighbors we are examining
- * @param num_cols The width of the world
- * @param num_rows The height of the world
+ * @param index Index of the cell we are updating
+ * @param stride Distance between vertically adjacent cells (num_cols+2)
  */
-void update_cell(int *curr_world, int *next_world, int x, int y, 
-					int num_cols, int num_rows) {
-	unsigned index = translate_to_1D(x, y, num_cols, num_rows);
-	unsigned num_live_neighbors = count_live_neighbors(curr_world, x, y, num_cols, num_rows);
-	if (curr_world[index] == 1
-			&& (num_live_neighbors < 2 || num_live_neighbors > 3)) {
-		/*
-		 * With my cross-bow,
-		 * I shot the albatross.
-		 */
-		next_world[index] = 0;
-	}
-	else if (num_live_neighbors == 3) {
-		/*
-		 * Oh! Dream of joy! Is this indeed
-		 * The light-house top I see?
-		 */
-		next_world[index] = 1;
-	}
-}
-
-int *initialize_world(char *config_filename, int *num_cols, int *num_rows) {
-	FILE *config_file = fopen(config_filename, "r");
-	if (config_file == NULL) {
-		return NULL;
+void update_cell(int *curr_world, int *next_world, unsigned index, unsigned stride) {
+	unsigned num_live_neighbors = count_live_neighbors(curr_world, index, stride);
+	/*
+	 * Oh! Dream of joy! Is this indeed
+	 * The light-house top I see?
+	 * (Otherwise: with my cross-bow, I shot the albatross.)
+	 */
+	next_world[index] = (transitions >> (curr_world[index]*9 + num_live_neighbors)) & 1;
+}
+
+// most threads the config file parser uses, and the least bytes each one
+// gets: smaller files are parsed by fewer threads
+#define CONFIG_MAX_THREADS 64
+#define CONFIG_MIN_CHUNK (1 << 20)
+
+/*
+ * One thread's share of the coordinate list of a config file.
+ */
+typedef struct ConfigChunk {
+	const char *start;	// the chunk, which never splits a number
+	const char *end;
+	const char *text_end;	// the end of the whole file
+	long long count;	// numbers in the chunk before any invalid character
+	bool bad;	// whether the chunk has an invalid character after them
+	long long first;	// index of its first number in the whole list
+	long long needed;	// numbers the file says there are (2 per pair)
+	int *world;
+	int num_cols;
+	int num_rows;
+	bool out_of_bounds;	// a pair of the chunk was outside the world
+} ConfigChunk;
+
+/*
+ * Returns true for the whitespace characters that can separate numbers.
+ */
+static inline bool is_blank(char c) {
+	return c == ' ' || c == '\n' || c == '\t' || c == '\r' || c == '\v' || c == '\f';
+}
+
+static inline bool is_digit(char c) {
+	return c >= '0' && c <= '9';
+}
+
+/*
+ * Parses the run of digits at *p (before end), moving *p past it. Values
+ * that do not fit in 32 bits come out as UINT32_MAX, which is outside any
+ * world.
+ */
+static uint64_t scan_number(const char **p, const char *end) {
+	const char *s = *p;
+	uint64_t value = 0;
+	while (s < end && is_digit(*s)) {
+		if (value < UINT32_MAX) {
+			value = value * 10 + (*s - '0');
+		}
+		s++;
 	}
+	*p = s;
+	return (value < UINT32_MAX) ? value : UINT32_MAX;
+}
 
-	unsigned int num_pairs;
-	if (fscanf(config_file, "%d", num_rows) != 1) {
-		return NULL;
+/*
+ * First pass over a chunk: counts its numbers, up to the first character
+ * that is neither a digit nor whitespace.
+ */
+static void *count_numbers(void *arg) {
+	ConfigChunk *chunk = arg;
+	long long count = 0;
+	bool in_number = false;
+	const char *p;
+	for (p = chunk->start; p < chunk->end; p++) {
+		if (is_digit(*p)) {
+			count += !in_number;
+			in_number = true;
+		}
+		else if (is_blank(*p)) {
+			in_number = false;
+		}
+		else {
+			break;
+		}
 	}
-	if (fscanf(config_file, "%d", num_cols) != 1) {
-		return NULL;
+	// a number running into a bad character does not count
+	chunk->bad = (p < chunk->end);
+	chunk->count = count - (chunk->bad && in_number);
+	return NULL;
+}
+
+/*
+ * Second pass over a chunk: sets the cell of every pair whose column is in
+ * the chunk, now that the index of its first number (and so whether that
+ * is a column or a row) is known. A pair's row may be in the next chunk.
+ */
+static void *set_pairs(void *arg) {
+	ConfigChunk *chunk = arg;
+	const char *p = chunk->start;
+	long long index = chunk->first;
+	long long last = chunk->first + chunk->count;
+	if (last > chunk->needed) {
+		last = chunk->needed;
 	}
-	if (fscanf(config_file, "%d", &num_pairs) != 1) {
-		return NULL;
+
+	while (index < last) {
+		while (is_blank(*p)) {
+			p++;
+		}
+		uint64_t col = scan_number(&p, chunk->text_end);
+		if (index++ % 2 == 1) {
+			// the row of a pair from the last chunk
+			continue;
+		}
+		while (is_blank(*p)) {
+			p++;
+		}
+		uint64_t row = scan_number(&p, chunk->text_end);
+		index++;
+
+		if (col >= (uint64_t)chunk->num_cols || row >= (uint64_t)chunk->num_rows) {
+			chunk->out_of_bounds = true;
+			continue;
+		}
+		// threads only ever store 1, so pairs repeated in two chunks are fine
+		chunk->world[translate_to_1D(col, row, chunk->num_cols, chunk->num_rows)] = 1;
 	}
+	return NULL;
+}
 
-	int *world = calloc(*num_cols * *num_rows, sizeof(int));
+/*
+ * Runs fn on every chunk, each on a thread of its own but the first.
+ */
+static void run_chunks(void *(*fn)(void *), ConfigChunk *chunks, int num_chunks) {
+	pthread_t tids[CONFIG_MAX_THREADS];
+	for (int i = 1; i < num_chunks; i++) {
+		if (pthread_create(&tids[i], NULL, fn, &chunks[i]) != 0) {
+			perror("pthread_create");
+			exit(EXIT_FAILURE);
+		}
+	}
+	fn(&chunks[0]);
+	for (int i = 1; i < num_chunks; i++) {
+		pthread_join(tids[i], NULL);
+	}
+}
 
-	for (unsigned i = 0; i < num_pairs; i++) {
-		unsigned col, row;
-		if (fscanf(config_file, "%u %u", &col, &row) != 2) {
-			// couldn't read the coordinate pair!
+/**
+ * Parses the text of a config file: the number of rows, of columns and of
+ * coordinate pairs, then the column and row of each live cell. The pairs
+ * are split into chunks parsed by several threads: a first pass counts the
+ * numbers in each chunk, so the second knows which of them are columns.
+ *
+ * @return The world, or NULL if the text is not a valid config.
+ */
+static int *parse_config(const char *text, size_t size, int *num_cols, int *num_rows) {
+	const char *p = text, *end = text + size;
+	uint64_t header[3];
+	for (int i = 0; i < 3; i++) {
+		while (p < end && is_blank(*p)) {
+			p++;
+		}
+		if (p == end || !is_digit(*p)) {
 			return NULL;
 		}
-
-		unsigned index = translate_to_1D(col, row, *num_cols, *num_rows);
-		world[index] = 1;
+		header[i] = scan_number(&p, end);
 	}
+	if (header[0] < 1 || header[1] < 1) {
+		return NULL;
+	}
+	if (header[0] > INT_MAX || header[1] > INT_MAX || !world_fits(header[1], header[0])) {
+		fprintf(stderr, "A %llux%llu world is too large\n", (unsigned long long)header[1],
+				(unsigned long long)header[0]);
+		return NULL;
+	}
+	*num_rows = header[0];
+	*num_cols = header[1];
 
-	fclose(config_file);
+	int *world = calloc(world_size(*num_cols, *num_rows), sizeof(int));
+	if (world == NULL) {
+		return NULL;
+	}
 
-	return world;
-}
+	// one chunk per megabyte, up to one per CPU
+	long num_cpus = sysconf(_SC_NPROCESSORS_ONLN);
+	size_t body = end - p;
+	int num_chunks = body / CONFIG_MIN_CHUNK + 1;
+	if (num_chunks > num_cpus) {
+		num_chunks = (num_cpus > 0) ? num_cpus : 1;
+	}
+	if (num_chunks > CONFIG_MAX_THREADS) {
+		num_chunks = CONFIG_MAX_THREADS;
+	}
 
-void update_world(int *world, int *world_copy, int num_cols, int num_rows, int start_row, int end_row) {
+	ConfigChunk chunks[CONFIG_MAX_THREADS];
+	for (int i = 0; i < num_chunks; i++) {
+		ConfigChunk *chunk = &chunks[i];
+		chunk->start = (i == 0) ? p : chunks[i - 1].end;
+		chunk->end = (i == num_chunks - 1) ? end : p + body / num_chunks * (i + 1);
+		if (chunk->end < chunk->start) {
+			chunk->end = chunk->start;
+		}
+		while (chunk->end < end && is_digit(*chunk->end)) {
+			chunk->end++;
+		}
+		chunk->text_end = end;
+		chunk->needed = 2 * header[2];
+		chunk->world = world;
+		chunk->num_cols = *num_cols;
+		chunk->num_rows = *num_rows;
+		chunk->out_of_bounds = false;
+	}
 
+	// the list ends at the first invalid character, and must have all the
+	// pairs by then
+	run_chunks(count_numbers, chunks, num_chunks);
+	long long total = 0;
+	bool stopped = false;
+	for (int i = 0; i < num_chunks; i++) {
+		if (stopped) {
+			chunks[i].count = 0;
+		}
+		chunks[i].first = total;
+		total += chunks[i].count;
+		stopped = stopped || chunks[i].bad;
+	}
+	if (total < 2 * (long long)header[2]) {
+		// couldn't read the coordinate pairs!
+		free(world);
+		return NULL;
+	}
 
-	for (int y = start_row; y <= end_row; y++) {
-		for (int x = 0; x < num_cols; x++) {
-			update_cell(world_copy, world, x, y, num_cols, num_rows);
+	run_chunks(set_pairs, chunks, num_chunks);
+	for (int i = 0; i < num_chunks; i++) {
+		if (chunks[i].out_of_bounds) {
+			fprintf(stderr, "Coordinate pair outside the %dx%d world\n", *num_cols, *num_rows);
+			free(world);
+			return NULL;
 		}
 	}
 
+	update_halo(world, *num_cols, *num_rows, 0, *num_rows - 1);
+	return world;
 }
 
-void print_world(int *world, int num_cols, int num_rows, int turn) {
-	clear(); // clears the screen
-
-	for (int row = 0; row < num_rows; row++) {
-		for (int col = 0; col < num_cols; col++) {
-			unsigned int index = translate_to_1D(col, row, num_cols, num_rows);
-			if (world[index] == 1) {
-				mvaddch(row, col, '@');
-			}
-			else {
-				mvaddch(row, col, '.');
-			}
-
+int *initialize_world(char *config_filename, int *num_cols, int *num_rows, Rule *rule) {
+	*rule = RULE_LIFE;
+	size_t name_len = strlen(config_filename);
+	if (name_len > 4 && strcmp(config_filename + name_len - 4, ".rle") == 0) {
+		char rule_text[64];
+		int *world = rle_read(config_filename, num_cols, num_rows, rule_text, sizeof(rule_text));
+		if (world != NULL && rule_parse(rule_text, rule) != 0) {
+			fprintf(stderr, "Unsupported rule: %s\n", rule_text);
+			free(world);
+			return NULL;
 		}
+		return world;
 	}
 
-	// print the turn number string below the board
-
+	int fd = open(config_filename, O_RDONLY);
+	if (fd < 0) {
+		return NULL;
+	}
+	struct stat st;
+	if (fstat(fd, &st) != 0 || st.st_size == 0) {
+		close(fd);
+		return NULL;
+	}
+	size_t size = st.st_size;
+	const char *text = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (text == MAP_FAILED) {
+		return NULL;
+	}
 
-	char turn_str[20];
-    memset(turn_str, 0, 20); // init string to all 0's
+	int *world = parse_config(text, size, num_cols, num_rows);
+	munmap((void *)text, size);
+	return world;
+}
 
-    sprintf(turn_str, "Time Step: %d", turn);
-    mvaddstr(num_rows + 1, 0, turn_str);
+void update_world(int *curr_world, int *next_world, int num_cols, int num_rows, int start_row, int end_row) {
+	unsigned stride = num_cols + 2;
 
+	for (int y = start_row; y <= end_row; y++) {
+		unsigned row_start = translate_to_1D(0, y, num_cols, num_rows);
+		for (int x = 0; x < num_cols; x++) {
+			update_cell(curr_world, next_world, row_start + x, stride);
+		}
+	}
 
-	refresh(); // displays the text we've added
+	update_halo(next_world, num_cols, num_rows, start_row, end_row);
 }
@@ -6,37 +6,100 @@
  * Header file of the game of life simulator functions.
  */
 
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "rule.h"
+
+/**
+ * Given 2D coordinates, compute the corresponding index in the 1D array.
+ * Coordinates up to one row/column outside the world wrap around.
+ *
+ * The array is padded with a one-cell halo on every side that mirrors the
+ * opposite edge of the (toroidal) world, so the neighbors of any cell are at
+ * fixed offsets from it: +-1 horizontally and +-(num_cols+2) vertically.
+ *
+ * @param col The x-coord we are converting
+ * @param row The y-coord we are converting
+ * @param num_cols The width of the world (i.e. number of columns)
+ * @param num_rows The height of the world (i.e. number of rows)
+ *
+ * @return Index into the 1D world array that corresponds to (x,y)
+ */
+unsigned int translate_to_1D(int col, int row, unsigned num_cols, unsigned num_rows);
+
+/**
+ * Returns the number of ints in a world array, including its halo.
+ *
+ * @param num_cols The width of the world.
+ * @param num_rows The height of the world.
+ */
+size_t world_size(int num_cols, int num_rows);
+
+/**
+ * Returns true if an int world of this size (halo included) fits in memory
+ * that translate_to_1D can index, false if it is too large or empty.
+ *
+ * @param num_cols The width of the world.
+ * @param num_rows The height of the world.
+ */
+bool world_fits(int num_cols, int num_rows);
+
+/**
+ * Refreshes the halo cells that mirror rows start_row through end_row:
+ * their left/right neighbors, plus the top/bottom halo rows if the range
+ * includes the last/first row. Must be called after those rows change.
+ *
+ * @param world The world whose halo to refresh.
+ * @param num_cols The width of the world.
+ * @param num_rows The height of the world.
+ * @param start_row First row that changed.
+ * @param end_row Last row that changed.
+ */
+void update_halo(int *world, int num_cols, int num_rows, int start_row, int end_row);
+
 /**
  * Creates an initializes the world based on the given configuration file.
+ * Files whose name ends in ".rle" are read as RLE patterns (see rle.h).
+ * Other files are mapped into memory and their coordinate pairs parsed by
+ * several threads at once; a pair outside the world is an error.
  *
  * @param config_filename The name of the file containing the simulation
  *    configuration data (e.g. world dimensions)
  * @param num_cols Location where to store the width of the world.
  * @param num_rows Location where to store the height of the world.
+ * @param rule Location where to store the rule of an RLE pattern; Life for
+ *    other files, which have none.
  *
  * @return A 1D array representing the created/initialized world, or NULL if
  *   if there was an problem with initialization.
  */
-int *initialize_world(char *config_filename, int *num_cols, int *num_rows);
+int *initialize_world(char *config_filename, int *num_cols, int *num_rows, Rule *rule);
 
 /**
- * Updates the world for one step of simulation, based on the rules of the
- * game of life.
+ * Sets the rule update_world simulates, Life by default. Any rule costs the
+ * same: the next state of a cell is looked up in a table of the rule's 18
+ * transitions instead of being compared against fixed counts. Should be
+ * called before any thread starts updating.
  *
- * @param world The world to update.
- * @param num_cols The width of the world.
- * @param num_rows The height of the world.
+ * @param rule The rule to simulate.
  */
-void update_world(int *world, int *world_copy, int num_cols, int num_rows, int start_row, int end_row);
+void set_rule(const Rule *rule);
 
 /**
- * Prints the given world using the ncurses UI library.
+ * Computes one step of simulation, based on the current rule (see
+ * set_rule), from one world buffer into another. Only rows start_row through end_row
+ * (and the halo cells mirroring them) of next_world are written, and every
+ * one of them is overwritten, so the two buffers can simply be swapped
+ * between turns.
  *
- * @param world The world to print.
+ * @param curr_world The world for the current turn (read-only).
+ * @param next_world The world for the next turn.
  * @param num_cols The width of the world.
  * @param num_rows The height of the world.
- * @param turn The current turn number.
+ * @param start_row First row to update.
+ * @param end_row Last row to update.
  */
-void print_world(int *world, int num_cols, int num_rows, int turn);
+void update_world(int *curr_world, int *next_world, int num_cols, int num_rows, int start_row, int end_row);
 
 #endif
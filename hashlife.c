@@ -0,0 +1,847 @@
+/**
+ * File: hashlife.c
+ *
+ * Implementation of the HashLife world: canonical quadtree nodes in a hash
+ * table, each memoizing its RESULT (the center half of the node some
+ * power-of-two number of generations later).
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include "gol.h"
+#include "hashlife.h"
+
+// deepest quadtree level; a level k node is 2^k cells on a side. Jumping
+// 2^63 generations needs a level 65 node.
+#define MAX_LEVEL 66
+
+// once the table holds this many nodes, everything not reachable from the
+// current world is dropped between jumps
+#define MAX_NODES ((size_t)1 << 22)
+
+// macrocell files store 8x8 (level 3) leaves as text
+#define MC_LEAF_LEVEL 3
+#define MC_LEAF_SIZE (1 << MC_LEAF_LEVEL)
+
+// deepest macrocell pattern that can be read, so its size fits in an int
+#define MC_MAX_LEVEL 30
+
+/*
+ * A quadtree node. Level 0 nodes are single cells; a level k node has four
+ * level k-1 children. Nodes are immutable and unique: two nodes with the
+ * same children are the same node, so they can be compared by pointer.
+ */
+typedef struct Node {
+	struct Node *nw, *ne, *sw, *se;
+	struct Node *next;	// next node in the same hash bucket
+	struct Node *result;	// memoized result, or NULL
+	struct Node *copy;	// this node in the new table, while compacting
+	int level;
+	int result_gens;	// log2 of the generations result is advanced by
+} Node;
+
+struct HashLife {
+	int num_cols;
+	int num_rows;
+	int level;	// level of root, 2^level = max(num_cols, num_rows)
+	Node *root;	// the world, repeated to fill a square if not square
+	Node *empty[MAX_LEVEL + 1];	// the all-dead node of each level, or NULL
+	Node cells[2];	// the dead and the live level 0 node
+	Rule rule;
+	Node **buckets;
+	size_t num_buckets;	// always a power of two
+	size_t num_nodes;
+};
+
+/**
+ * Returns the hash bucket of the node with the given children.
+ */
+static size_t bucket_of(const HashLife *hl, const Node *nw, const Node *ne,
+		const Node *sw, const Node *se) {
+	uint64_t h = (uintptr_t)nw;
+	h = h * 0x9E3779B97F4A7C15ull + (uintptr_t)ne;
+	h = h * 0x9E3779B97F4A7C15ull + (uintptr_t)sw;
+	h = h * 0x9E3779B97F4A7C15ull + (uintptr_t)se;
+	h ^= h >> 29;
+	return h & (hl->num_buckets - 1);
+}
+
+/**
+ * Allocates an empty hash table, exiting if memory runs out.
+ */
+static Node **alloc_buckets(size_t num_buckets) {
+	Node **buckets = calloc(num_buckets, sizeof(Node *));
+	if (buckets == NULL) {
+		perror("hashlife");
+		exit(EXIT_FAILURE);
+	}
+	return buckets;
+}
+
+/**
+ * Doubles the number of hash buckets.
+ */
+static void grow_table(HashLife *hl) {
+	Node **old = hl->buckets;
+	size_t old_size = hl->num_buckets;
+
+	hl->num_buckets *= 2;
+	hl->buckets = alloc_buckets(hl->num_buckets);
+	for (size_t b = 0; b < old_size; b++) {
+		Node *n = old[b];
+		while (n != NULL) {
+			Node *next = n->next;
+			size_t nb = bucket_of(hl, n->nw, n->ne, n->sw, n->se);
+			n->next = hl->buckets[nb];
+			hl->buckets[nb] = n;
+			n = next;
+		}
+	}
+	free(old);
+}
+
+/**
+ * Returns the canonical node with the given children, creating it if it
+ * does not exist yet.
+ */
+static Node *join(HashLife *hl, Node *nw, Node *ne, Node *sw, Node *se) {
+	size_t b = bucket_of(hl, nw, ne, sw, se);
+	for (Node *n = hl->buckets[b]; n != NULL; n = n->next) {
+		if (n->nw == nw && n->ne == ne && n->sw == sw && n->se == se) {
+			return n;
+		}
+	}
+
+	Node *n = malloc(sizeof(Node));
+	if (n == NULL) {
+		perror("hashlife");
+		exit(EXIT_FAILURE);
+	}
+	n->nw = nw;
+	n->ne = ne;
+	n->sw = sw;
+	n->se = se;
+	n->result = NULL;
+	n->copy = NULL;
+	n->level = nw->level + 1;
+	n->result_gens = -1;
+	n->next = hl->buckets[b];
+	hl->buckets[b] = n;
+
+	if (++hl->num_nodes > hl->num_buckets) {
+		grow_table(hl);
+	}
+	return n;
+}
+
+/**
+ * Returns the all-dead node of the given level.
+ */
+static Node *empty_node(HashLife *hl, int level) {
+	if (hl->empty[level] == NULL) {
+		Node *e = (level == 0) ? &hl->cells[0] : empty_node(hl, level - 1);
+		hl->empty[level] = (level == 0) ? e : join(hl, e, e, e, e);
+	}
+	return hl->empty[level];
+}
+
+/**
+ * Returns the level k-1 node at the center of a level k node.
+ */
+static Node *centered(HashLife *hl, const Node *n) {
+	return join(hl, n->nw->se, n->ne->sw, n->sw->ne, n->se->nw);
+}
+
+/**
+ * Returns 1 if the cell at (col, row) of a node is alive, 0 otherwise.
+ */
+static int node_get(const Node *n, int col, int row) {
+	while (n->level > 0) {
+		int half = 1 << (n->level - 1);
+		if (row < half) {
+			n = (col < half) ? n->nw : n->ne;
+		}
+		else {
+			n = (col < half) ? n->sw : n->se;
+			row -= half;
+		}
+		if (col >= half) {
+			col -= half;
+		}
+	}
+	return n->level == 0 && n->nw != NULL;
+}
+
+/**
+ * Computes the center 2x2 cells of a level 2 (4x4) node one generation
+ * later, by counting neighbors directly.
+ */
+static Node *result_level2(HashLife *hl, const Node *n) {
+	int cells[4][4];
+	for (int row = 0; row < 4; row++) {
+		for (int col = 0; col < 4; col++) {
+			cells[row][col] = node_get(n, col, row);
+		}
+	}
+
+	Node *out[2][2];
+	for (int row = 1; row <= 2; row++) {
+		for (int col = 1; col <= 2; col++) {
+			int live = 0;
+			for (int dy = -1; dy <= 1; dy++) {
+				for (int dx = -1; dx <= 1; dx++) {
+					live += cells[row + dy][col + dx];
+				}
+			}
+			live -= cells[row][col];
+			int alive = ((cells[row][col] ? hl->rule.survive : hl->rule.birth) >> live) & 1;
+			out[row - 1][col - 1] = &hl->cells[alive];
+		}
+	}
+	return join(hl, out[0][0], out[0][1], out[1][0], out[1][1]);
+}
+
+/**
+ * Returns the level k-1 node at the center of a level k node, 2^gens
+ * generations later. gens can be at most k-2: any further and cells from
+ * outside the node could reach the center.
+ *
+ * @param n The node to advance.
+ * @param gens log2 of the number of generations.
+ */
+static Node *result(HashLife *hl, Node *n, int gens) {
+	if (n->result != NULL && n->result_gens == gens) {
+		return n->result;
+	}
+
+	Node *r;
+	// empty space stays empty, unless dead cells with no neighbors are born
+	if (n == empty_node(hl, n->level) && !(hl->rule.birth & 1)) {
+		r = empty_node(hl, n->level - 1);
+	}
+	else if (n->level == 2) {
+		r = result_level2(hl, n);
+	}
+	else {
+		// the nine overlapping level k-1 squares of the node
+		Node *sq[3][3] = {
+			{n->nw, join(hl, n->nw->ne, n->ne->nw, n->nw->se, n->ne->sw), n->ne},
+			{join(hl, n->nw->sw, n->nw->se, n->sw->nw, n->sw->ne),
+				join(hl, n->nw->se, n->ne->sw, n->sw->ne, n->se->nw),
+				join(hl, n->ne->sw, n->ne->se, n->se->nw, n->se->ne)},
+			{n->sw, join(hl, n->sw->ne, n->se->nw, n->sw->se, n->se->sw), n->se},
+		};
+
+		// at full speed each half of the jump is done by a level k-1 result;
+		// for shorter jumps the first half only takes the centers
+		bool full = (gens == n->level - 2);
+		Node *mid[3][3];
+		for (int y = 0; y < 3; y++) {
+			for (int x = 0; x < 3; x++) {
+				mid[y][x] = full ? result(hl, sq[y][x], gens - 1) : centered(hl, sq[y][x]);
+			}
+		}
+
+		int second = full ? gens - 1 : gens;
+		Node *quad[2][2];
+		for (int y = 0; y < 2; y++) {
+			for (int x = 0; x < 2; x++) {
+				quad[y][x] = result(hl, join(hl, mid[y][x], mid[y][x + 1],
+						mid[y + 1][x], mid[y + 1][x + 1]), second);
+			}
+		}
+		r = join(hl, quad[0][0], quad[0][1], quad[1][0], quad[1][1]);
+	}
+
+	n->result = r;
+	n->result_gens = gens;
+	return r;
+}
+
+/**
+ * Builds the node of the given level whose top-left cell is (col, row) of
+ * the int-per-cell world, repeating the world past its edges.
+ */
+static Node *build(HashLife *hl, int *world, int col, int row, int level) {
+	if (level == 0) {
+		int index = translate_to_1D(col % hl->num_cols, row % hl->num_rows,
+				hl->num_cols, hl->num_rows);
+		return &hl->cells[world[index] == 1];
+	}
+
+	int half = 1 << (level - 1);
+	return join(hl, build(hl, world, col, row, level - 1),
+			build(hl, world, col + half, row, level - 1),
+			build(hl, world, col, row + half, level - 1),
+			build(hl, world, col + half, row + half, level - 1));
+}
+
+/**
+ * Returns the copy of a node in the current table, creating it (and its
+ * children) if needed.
+ */
+static Node *copy_node(HashLife *hl, Node *n) {
+	if (n->level == 0) {
+		return n;
+	}
+	if (n->copy == NULL) {
+		n->copy = join(hl, copy_node(hl, n->nw), copy_node(hl, n->ne),
+				copy_node(hl, n->sw), copy_node(hl, n->se));
+	}
+	return n->copy;
+}
+
+/**
+ * Frees every node of a hash table.
+ */
+static void free_nodes(Node **buckets, size_t num_buckets) {
+	for (size_t b = 0; b < num_buckets; b++) {
+		Node *n = buckets[b];
+		while (n != NULL) {
+			Node *next = n->next;
+			free(n);
+			n = next;
+		}
+	}
+	free(buckets);
+}
+
+/**
+ * Moves the nodes of the world into a new table and frees all the others,
+ * along with every memoized result.
+ */
+static void compact(HashLife *hl) {
+	Node **old = hl->buckets;
+	size_t old_size = hl->num_buckets;
+
+	hl->num_buckets = 1 << 16;
+	hl->buckets = alloc_buckets(hl->num_buckets);
+	hl->num_nodes = 0;
+	memset(hl->empty, 0, sizeof(hl->empty));
+	hl->root = copy_node(hl, hl->root);
+
+	free_nodes(old, old_size);
+}
+
+/**
+ * Advances the world by 2^gens generations.
+ *
+ * The world tiles the plane, so a node made of copies of the root is that
+ * plane too, and its result is the plane later on. Its top-left corner
+ * starts 2^(k-2) cells into the node, a multiple of the root's size, so the
+ * corner of the result is exactly the new root.
+ */
+static void jump(HashLife *hl, int gens) {
+	int level = hl->level + 2;
+	if (level < gens + 2) {
+		level = gens + 2;
+	}
+
+	Node *tiled = hl->root;
+	while (tiled->level < level) {
+		tiled = join(hl, tiled, tiled, tiled, tiled);
+	}
+
+	Node *r = result(hl, tiled, gens);
+	while (r->level > hl->level) {
+		r = r->nw;
+	}
+	hl->root = r;
+
+	if (hl->num_nodes > MAX_NODES) {
+		compact(hl);
+	}
+}
+
+/**
+ * Returns log2 of n if n is a power of two, or -1 otherwise.
+ */
+static int log2_exact(int n) {
+	int level = 0;
+	if (n <= 0 || (n & (n - 1)) != 0) {
+		return -1;
+	}
+	while ((1 << level) < n) {
+		level++;
+	}
+	return level;
+}
+
+/**
+ * Allocates a world with an empty hash table, for a root of the given
+ * level.
+ */
+static HashLife *alloc_hashlife(int num_cols, int num_rows, int level) {
+	HashLife *hl = calloc(1, sizeof(HashLife));
+	if (hl == NULL) {
+		return NULL;
+	}
+
+	hl->num_cols = num_cols;
+	hl->num_rows = num_rows;
+	hl->level = level;
+	// the dead cell has no children, the live one points to itself
+	hl->cells[1].nw = &hl->cells[1];
+	hl->rule = RULE_LIFE;
+	hl->num_buckets = 1 << 16;
+	hl->buckets = alloc_buckets(hl->num_buckets);
+	return hl;
+}
+
+HashLife *hashlife_from_cells(int *world, int num_cols, int num_rows) {
+	int col_level = log2_exact(num_cols), row_level = log2_exact(num_rows);
+	if (col_level < 0 || row_level < 0) {
+		return NULL;
+	}
+
+	HashLife *hl = alloc_hashlife(num_cols, num_rows,
+			(col_level > row_level) ? col_level : row_level);
+	if (hl == NULL) {
+		return NULL;
+	}
+	hl->root = build(hl, world, 0, 0, hl->level);
+
+	return hl;
+}
+
+/**
+ * Stores the live cells of a node whose top-left cell is (col, row) of a
+ * region into the region's int-per-cell world, skipping any outside it.
+ * Positions are 64-bit since the root can be far larger than the region.
+ */
+static void store(const HashLife *hl, const Node *n, int *world, int num_cols, int num_rows,
+		int64_t col, int64_t row) {
+	int64_t size = (int64_t)1 << n->level;
+	if (col >= num_cols || row >= num_rows || col + size <= 0 || row + size <= 0
+			|| n == hl->empty[n->level]) {
+		return;
+	}
+	if (n->level == 0) {
+		if (n == &hl->cells[1]) {
+			world[translate_to_1D(col, row, num_cols, num_rows)] = 1;
+		}
+		return;
+	}
+
+	int64_t half = size / 2;
+	store(hl, n->nw, world, num_cols, num_rows, col, row);
+	store(hl, n->ne, world, num_cols, num_rows, col + half, row);
+	store(hl, n->sw, world, num_cols, num_rows, col, row + half);
+	store(hl, n->se, world, num_cols, num_rows, col + half, row + half);
+}
+
+void hashlife_region_to_cells(const HashLife *hl, int *world, int col, int row,
+		int num_cols, int num_rows) {
+	memset(world, 0, world_size(num_cols, num_rows)*sizeof(int));
+
+	// the root repeats the world, so the plane is copies of the root
+	int64_t size = (int64_t)1 << hl->level;
+	for (int64_t y = -(row % size); y < num_rows; y += size) {
+		for (int64_t x = -(col % size); x < num_cols; x += size) {
+			store(hl, hl->root, world, num_cols, num_rows, x, y);
+		}
+	}
+	update_halo(world, num_cols, num_rows, 0, num_rows - 1);
+}
+
+/**
+ * Counts the live cells of a node whose top-left cell is (col, row) of a
+ * region that are inside the region, skipping dead subtrees.
+ */
+static int64_t count(const HashLife *hl, const Node *n, int num_cols, int num_rows, int64_t col, int64_t row) {
+	int64_t size = (int64_t)1 << n->level;
+	if (col >= num_cols || row >= num_rows || col + size <= 0 || row + size <= 0
+			|| n == hl->empty[n->level]) {
+		return 0;
+	}
+	if (n->level == 0) {
+		return n == &hl->cells[1];
+	}
+
+	int64_t half = size / 2;
+	return count(hl, n->nw, num_cols, num_rows, col, row)
+			+ count(hl, n->ne, num_cols, num_rows, col + half, row)
+			+ count(hl, n->sw, num_cols, num_rows, col, row + half)
+			+ count(hl, n->se, num_cols, num_rows, col + half, row + half);
+}
+
+int64_t hashlife_region_count(const HashLife *hl, int col, int row, int num_cols, int num_rows) {
+	int64_t size = (int64_t)1 << hl->level;
+	int64_t total = 0;
+	for (int64_t y = -(row % size); y < num_rows; y += size) {
+		for (int64_t x = -(col % size); x < num_cols; x += size) {
+			total += count(hl, hl->root, num_cols, num_rows, x, y);
+		}
+	}
+	return total;
+}
+
+void hashlife_to_cells(const HashLife *hl, int *world) {
+	hashlife_region_to_cells(hl, world, 0, 0, hl->num_cols, hl->num_rows);
+}
+
+/**
+ * Builds the node of the given level whose top-left cell is (col, row) of
+ * an 8x8 macrocell leaf, given as one byte per row with bit c for column c.
+ */
+static Node *build_leaf(HashLife *hl, const uint8_t *rows, int col, int row, int level) {
+	if (level == 0) {
+		return &hl->cells[(rows[row] >> col) & 1];
+	}
+
+	int half = 1 << (level - 1);
+	return join(hl, build_leaf(hl, rows, col, row, level - 1),
+			build_leaf(hl, rows, col + half, row, level - 1),
+			build_leaf(hl, rows, col, row + half, level - 1),
+			build_leaf(hl, rows, col + half, row + half, level - 1));
+}
+
+/**
+ * Parses a macrocell leaf line ("." dead, "*" alive, "$" end of row).
+ * Returns false if it is not a valid leaf.
+ */
+static bool parse_leaf(const char *line, uint8_t rows[MC_LEAF_SIZE]) {
+	int row = 0, col = 0;
+	memset(rows, 0, MC_LEAF_SIZE);
+	for (const char *c = line; *c != '\0' && *c != '\n' && *c != '\r'; c++) {
+		if (*c == '$') {
+			row++;
+			col = 0;
+		}
+		else if ((*c == '.' || *c == '*') && row < MC_LEAF_SIZE && col < MC_LEAF_SIZE) {
+			rows[row] |= (*c == '*') << col;
+			col++;
+		}
+		else {
+			return false;
+		}
+	}
+	return true;
+}
+
+/**
+ * Returns a node whose top rows rows (a power of two) are those of n and
+ * repeat all the way down it, for a node that is empty below them.
+ */
+static Node *repeat_down(HashLife *hl, Node *n, int64_t rows) {
+	int64_t size = (int64_t)1 << n->level;
+	if (rows >= size || n == empty_node(hl, n->level)) {
+		return n;
+	}
+	Node *nw = repeat_down(hl, n->nw, rows), *ne = repeat_down(hl, n->ne, rows);
+	return join(hl, nw, ne, nw, ne);
+}
+
+/**
+ * Returns a node whose left cols columns (a power of two) are those of n and
+ * repeat all the way across it, for a node that is empty right of them.
+ */
+static Node *repeat_right(HashLife *hl, Node *n, int64_t cols) {
+	int64_t size = (int64_t)1 << n->level;
+	if (cols >= size || n == empty_node(hl, n->level)) {
+		return n;
+	}
+	Node *nw = repeat_right(hl, n->nw, cols), *sw = repeat_right(hl, n->sw, cols);
+	return join(hl, nw, nw, sw, sw);
+}
+
+HashLife *hashlife_read_mc(const char *filename, int *num_cols, int *num_rows,
+		char *rule, size_t rule_size) {
+	FILE *file = fopen(filename, "r");
+	if (file == NULL) {
+		return NULL;
+	}
+
+	HashLife *hl = alloc_hashlife(0, 0, 0);
+	// nodes[i] is the node of the i-th node line; 0 stands for empty
+	size_t num_nodes = 1, max_nodes = 1 << 10;
+	Node **nodes = malloc(max_nodes * sizeof(Node *));
+	if (hl == NULL || nodes == NULL) {
+		fclose(file);
+		hashlife_free(hl);
+		free(nodes);
+		return NULL;
+	}
+
+	snprintf(rule, rule_size, "B3/S23");
+	int world_cols = 0, world_rows = 0;	// the size of a world that is not square
+	char line[256];
+	bool ok = (fgets(line, sizeof(line), file) != NULL && strncmp(line, "[M2]", 4) == 0);
+	while (ok && fgets(line, sizeof(line), file) != NULL) {
+		Node *n;
+		int level, kids[4];
+		if (line[0] == '#') {
+			// comments, except for the rule and the size of the world
+			if (line[1] == 'R') {
+				const char *start = line + 2 + strspn(line + 2, " \t");
+				snprintf(rule, rule_size, "%.*s", (int)strcspn(start, " \t\r\n"), start);
+			}
+			else {
+				int cols, rows;
+				if (sscanf(line, "#C world %d %d", &cols, &rows) == 2) {
+					world_cols = cols;
+					world_rows = rows;
+				}
+			}
+			continue;
+		}
+		else if (line[0] == '.' || line[0] == '*' || line[0] == '$') {
+			uint8_t rows[MC_LEAF_SIZE];
+			ok = parse_leaf(line, rows);
+			n = ok ? build_leaf(hl, rows, 0, 0, MC_LEAF_LEVEL) : NULL;
+		}
+		else if (sscanf(line, "%d %d %d %d %d", &level, &kids[0], &kids[1], &kids[2], &kids[3]) == 5) {
+			Node *child[4];
+			ok = (level > MC_LEAF_LEVEL && level <= MC_MAX_LEVEL);
+			for (int i = 0; i < 4 && ok; i++) {
+				ok = (kids[i] >= 0 && (size_t)kids[i] < num_nodes);
+				if (ok) {
+					child[i] = (kids[i] == 0) ? empty_node(hl, level - 1) : nodes[kids[i]];
+					ok = (child[i]->level == level - 1);
+				}
+			}
+			n = ok ? join(hl, child[0], child[1], child[2], child[3]) : NULL;
+		}
+		else {
+			ok = (line[strspn(line, " \t\r\n")] == '\0');	// allow blank lines
+			continue;
+		}
+
+		if (ok && num_nodes == max_nodes) {
+			max_nodes *= 2;
+			Node **bigger = realloc(nodes, max_nodes * sizeof(Node *));
+			if (bigger == NULL) {
+				ok = false;
+				break;
+			}
+			nodes = bigger;
+		}
+		if (ok) {
+			nodes[num_nodes++] = n;
+		}
+	}
+	fclose(file);
+
+	if (!ok || num_nodes == 1) {
+		free(nodes);
+		hashlife_free(hl);
+		return NULL;
+	}
+
+	// the last node is the whole pattern
+	hl->root = nodes[num_nodes - 1];
+	hl->level = hl->root->level;
+	hl->num_cols = hl->num_rows = 1 << hl->level;
+	free(nodes);
+
+	// a world that is not square was saved as its top-left corner of the
+	// root, which the root repeats once it is simulated
+	int col_level = log2_exact(world_cols), row_level = log2_exact(world_rows);
+	if (col_level >= 0 && row_level >= 0 && col_level <= hl->level && row_level <= hl->level) {
+		int level = (col_level > row_level) ? col_level : row_level;
+		Node *root = hl->root;
+		while (root->level > level) {
+			root = root->nw;
+		}
+		hl->root = repeat_right(hl, repeat_down(hl, root, world_rows), world_cols);
+		hl->level = level;
+		hl->num_cols = world_cols;
+		hl->num_rows = world_rows;
+	}
+
+	*num_cols = hl->num_cols;
+	*num_rows = hl->num_rows;
+	return hl;
+}
+
+/*
+ * Numbers of the nodes already written to a macrocell file, in a hash
+ * table keyed by node.
+ */
+typedef struct NodeIds {
+	const Node **keys;
+	size_t *ids;
+	size_t size;	// always a power of two
+	size_t count;
+} NodeIds;
+
+static size_t node_slot(const NodeIds *ids, const Node *n) {
+	size_t slot = ((uintptr_t)n * 0x9E3779B97F4A7C15ull >> 17) & (ids->size - 1);
+	while (ids->keys[slot] != NULL && ids->keys[slot] != n) {
+		slot = (slot + 1) & (ids->size - 1);
+	}
+	return slot;
+}
+
+/**
+ * Records the number of a node, exiting if memory runs out.
+ */
+static void add_node_id(NodeIds *ids, const Node *n, size_t id) {
+	if (2 * (ids->count + 1) > ids->size) {
+		NodeIds bigger = {
+			.keys = calloc(2 * ids->size, sizeof(Node *)),
+			.ids = malloc(2 * ids->size * sizeof(size_t)),
+			.size = 2 * ids->size,
+			.count = ids->count,
+		};
+		if (bigger.keys == NULL || bigger.ids == NULL) {
+			perror("hashlife");
+			exit(EXIT_FAILURE);
+		}
+		for (size_t i = 0; i < ids->size; i++) {
+			if (ids->keys[i] != NULL) {
+				size_t slot = node_slot(&bigger, ids->keys[i]);
+				bigger.keys[slot] = ids->keys[i];
+				bigger.ids[slot] = ids->ids[i];
+			}
+		}
+		free(ids->keys);
+		free(ids->ids);
+		*ids = bigger;
+	}
+
+	size_t slot = node_slot(ids, n);
+	ids->keys[slot] = n;
+	ids->ids[slot] = id;
+	ids->count++;
+}
+
+/**
+ * Writes a node and, before it, any of its descendants not written yet.
+ * Returns the number of its line, or 0 for an empty node.
+ */
+static size_t write_node(const HashLife *hl, const Node *n, FILE *file, NodeIds *ids) {
+	if (n == hl->empty[n->level]) {
+		return 0;
+	}
+	size_t slot = node_slot(ids, n);
+	if (ids->keys[slot] == n) {
+		return ids->ids[slot];
+	}
+
+	if (n->level == MC_LEAF_LEVEL) {
+		// rows end in '$', leaving out their trailing dead cells and the
+		// empty rows at the bottom
+		int ends[MC_LEAF_SIZE], last_row = -1;
+		for (int row = 0; row < MC_LEAF_SIZE; row++) {
+			ends[row] = MC_LEAF_SIZE;
+			while (ends[row] > 0 && !node_get(n, ends[row] - 1, row)) {
+				ends[row]--;
+			}
+			if (ends[row] > 0) {
+				last_row = row;
+			}
+		}
+		for (int row = 0; row <= last_row; row++) {
+			for (int col = 0; col < ends[row]; col++) {
+				fputc(node_get(n, col, row) ? '*' : '.', file);
+			}
+			fputc('$', file);
+		}
+		fputc('\n', file);
+	}
+	else {
+		size_t nw = write_node(hl, n->nw, file, ids);
+		size_t ne = write_node(hl, n->ne, file, ids);
+		size_t sw = write_node(hl, n->sw, file, ids);
+		size_t se = write_node(hl, n->se, file, ids);
+		fprintf(file, "%d %zu %zu %zu %zu\n", n->level, nw, ne, sw, se);
+	}
+
+	size_t id = ids->count + 1;
+	add_node_id(ids, n, id);
+	return id;
+}
+
+/**
+ * Returns the node whose top-left cell is (col, row) of the root with every
+ * cell outside the num_cols by num_rows world dead, dropping the copies
+ * that fill out the root of a world that is not square.
+ */
+static Node *crop(HashLife *hl, Node *n, int64_t col, int64_t row) {
+	int64_t size = (int64_t)1 << n->level;
+	if (col + size <= hl->num_cols && row + size <= hl->num_rows) {
+		return n;
+	}
+	if (col >= hl->num_cols || row >= hl->num_rows) {
+		return empty_node(hl, n->level);
+	}
+
+	int64_t half = size / 2;
+	return join(hl, crop(hl, n->nw, col, row), crop(hl, n->ne, col + half, row),
+			crop(hl, n->sw, col, row + half), crop(hl, n->se, col + half, row + half));
+}
+
+int hashlife_write_mc(HashLife *hl, const char *filename, const char *rule) {
+	FILE *file = fopen(filename, "w");
+	if (file == NULL) {
+		return -1;
+	}
+
+	// the format has no nodes smaller than a leaf, so small worlds are padded
+	Node *root = crop(hl, hl->root, 0, 0);
+	while (root->level < MC_LEAF_LEVEL) {
+		Node *e = empty_node(hl, root->level);
+		root = join(hl, root, e, e, e);
+	}
+	empty_node(hl, root->level);	// so write_node can recognize empty nodes
+
+	fprintf(file, "[M2] (parallelgol)\n#R %s\n", rule);
+	if (hl->num_cols != hl->num_rows) {
+		fprintf(file, "#C world %d %d\n", hl->num_cols, hl->num_rows);
+	}
+	NodeIds ids = {
+		.keys = calloc(1 << 10, sizeof(Node *)),
+		.ids = malloc((1 << 10) * sizeof(size_t)),
+		.size = 1 << 10,
+		.count = 0,
+	};
+	if (ids.keys == NULL || ids.ids == NULL) {
+		perror("hashlife");
+		exit(EXIT_FAILURE);
+	}
+	if (write_node(hl, root, file, &ids) == 0) {
+		// an empty world still needs a root, on top of an empty leaf
+		fprintf(file, "$\n");
+		for (int level = MC_LEAF_LEVEL + 1; level <= root->level; level++) {
+			fprintf(file, "%d %d 0 0 0\n", level, level - MC_LEAF_LEVEL);
+		}
+	}
+	free(ids.keys);
+	free(ids.ids);
+
+	return (fclose(file) == 0) ? 0 : -1;
+}
+
+void hashlife_set_rule(HashLife *hl, const Rule *rule) {
+	if (rule_equal(&hl->rule, rule)) {
+		return;
+	}
+	hl->rule = *rule;
+	// the results remembered so far are those of the old rule
+	for (size_t b = 0; b < hl->num_buckets; b++) {
+		for (Node *n = hl->buckets[b]; n != NULL; n = n->next) {
+			n->result = NULL;
+		}
+	}
+}
+
+void hashlife_step(HashLife *hl, uint64_t generations) {
+	for (int gens = 63; gens >= 0; gens--) {
+		if ((generations >> gens) & 1) {
+			jump(hl, gens);
+		}
+	}
+}
+
+void hashlife_free(HashLife *hl) {
+	if (hl == NULL) {
+		return;
+	}
+	free_nodes(hl->buckets, hl->num_buckets);
+	free(hl);
+}
@@ -0,0 +1,131 @@
+#ifndef __HASHLIFE_H__
+#define __HASHLIFE_H__
+/**
+ * File: hashlife.h
+ *
+ * HashLife representation of the game of life world: a quadtree whose
+ * nodes are hash-consed (identical subtrees are stored once) and which
+ * remembers the future of every node it has computed, so repetitive
+ * patterns can be advanced 2^k generations in a single step.
+ *
+ * The world is a torus like the other representations, which HashLife
+ * treats as a plane tiled with copies of it. For the copies to line up with
+ * the quadtree, its width and height must both be powers of two.
+ */
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "rule.h"
+
+typedef struct HashLife HashLife;
+
+/**
+ * Creates a HashLife world from a world returned by initialize_world.
+ *
+ * @param world The int-per-cell world to convert.
+ * @param num_cols The width of the world; must be a power of two.
+ * @param num_rows The height of the world; must be a power of two.
+ *
+ * @return The new world, or NULL if the dimensions are not powers of two or
+ *   it could not be allocated.
+ */
+HashLife *hashlife_from_cells(int *world, int num_cols, int num_rows);
+
+/**
+ * Stores the cells of a HashLife world into an int-per-cell world of the
+ * same size.
+ *
+ * @param hl The world to read.
+ * @param world Location where to store the cells.
+ */
+void hashlife_to_cells(const HashLife *hl, int *world);
+
+/**
+ * Stores a region of a HashLife world into an int-per-cell world the size
+ * of the region, so only the part that is needed is ever expanded. The
+ * region wraps around the edges of the world like the world itself.
+ *
+ * @param hl The world to read.
+ * @param world Location where to store the cells.
+ * @param col The column of the region's top-left cell (at least 0).
+ * @param row The row of the region's top-left cell (at least 0).
+ * @param num_cols The width of the region.
+ * @param num_rows The height of the region.
+ */
+void hashlife_region_to_cells(const HashLife *hl, int *world, int col, int row,
+		int num_cols, int num_rows);
+
+/**
+ * Returns the number of live cells in a region of a HashLife world, which
+ * wraps around the edges of the world like in hashlife_region_to_cells.
+ * Only the nodes of the region that are not empty are visited.
+ *
+ * @param hl The world to count in.
+ * @param col The column of the region's top-left cell (at least 0).
+ * @param row The row of the region's top-left cell (at least 0).
+ * @param num_cols The width of the region.
+ * @param num_rows The height of the region.
+ */
+int64_t hashlife_region_count(const HashLife *hl, int col, int row, int num_cols, int num_rows);
+
+/**
+ * Reads a pattern in Golly's macrocell (.mc) format, which stores the
+ * quadtree itself, straight into a HashLife world. The world is the
+ * smallest square that holds the root node, up to 2^30 cells on a side,
+ * unless the file records the size of a world that is not square (as
+ * hashlife_write_mc does in a comment line).
+ *
+ * @param filename The name of the macrocell file.
+ * @param num_cols Location where to store the width of the world.
+ * @param num_rows Location where to store the height of the world.
+ * @param rule Location where to store the rule of the pattern ("B3/S23" if
+ *   it has none), truncated to rule_size - 1 characters.
+ * @param rule_size The size of rule.
+ *
+ * @return The new world, or NULL if the file could not be read or is not a
+ *   valid two-state macrocell pattern.
+ */
+HashLife *hashlife_read_mc(const char *filename, int *num_cols, int *num_rows,
+		char *rule, size_t rule_size);
+
+/**
+ * Writes a HashLife world in Golly's macrocell (.mc) format, one line per
+ * distinct node, so the file is as small as the quadtree. The format only
+ * has square worlds, so the size of one that is not square is recorded in
+ * a "#C world <cols> <rows>" comment, which other programs ignore.
+ *
+ * @param hl The world to write.
+ * @param filename The name of the file to write.
+ * @param rule The rule to record in the file.
+ *
+ * @return 0 on success, -1 if the file could not be written.
+ */
+int hashlife_write_mc(HashLife *hl, const char *filename, const char *rule);
+
+/**
+ * Sets the rule a HashLife world is simulated with, Life unless set. The
+ * futures it remembers under the old rule are forgotten.
+ *
+ * @param hl The world.
+ * @param rule The rule to simulate.
+ */
+void hashlife_set_rule(HashLife *hl, const Rule *rule);
+
+/**
+ * Advances the world by the given number of generations, as a sum of
+ * power-of-two jumps.
+ *
+ * @param hl The world to advance.
+ * @param generations The number of generations to simulate.
+ */
+void hashlife_step(HashLife *hl, uint64_t generations);
+
+/**
+ * Frees a world created by hashlife_from_cells or hashlife_read_mc.
+ *
+ * @param hl The world to free.
+ */
+void hashlife_free(HashLife *hl);
+
+#endif
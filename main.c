@@ -16,36 +16,208 @@
 #include <string.h>
 #include <stdbool.h>
 #include <curses.h>
-#include <pthread.h>
+#include <time.h>
+#include <stdint.h>
 
 #include "gol.h"
-//declare the ThreadData fields
-struct ThreadData {
-	int id;
-	int *world;
-	int width;
-	int height;
-	int delay;
-	int num_turns;
-	int start_row;
-	int end_row;
-	pthread_barrier_t *barrier;	
-	int *world_copy;
-};
-//initialize the functions 
-typedef struct ThreadData ThreadData;
-void* thread_function(void* args);
-void run_threads(int num_threads, int num_turns, int *world, int width, int height, int delay);
+#include "bitworld.h"
+#include "hashlife.h"
+#include "sim.h"
+#include "rle.h"
+#include "checkpoint.h"
+#include "render.h"
+
 /**
  * Function that prints out how to use the program, in case the user forgets.
  *
  * @param prog_name The name of the executable.
  */
 static void usage(char *prog_name) {
-	fprintf(stderr, "usage: %s [-s] -c <config-file> -t <number of turns> -d <delay in ms> -p <parallelism>\n", prog_name);
+	fprintf(stderr, "usage: %s [-s] [-q] -c <config-file> -t <number of turns> -d <ms between frames> -p <parallelism> -k <int|byte|auto|bit|lut|swar|sse2|avx2|avx512|hashlife> [-b <generations per tile visit>] [-a] [-o <output.rle|output.mc>] [-r <col>,<row>,<cols>,<rows>] [-w <checkpoint.ckpt> [-e <generations between checkpoints>]] [-v] [-R <rule, e.g. B36/S23>]\n", prog_name);
 	exit(1);
 }
 
+/**
+ * Simulates the world with one of the engines and run_threads.
+ *
+ * @param engine The engine to simulate with.
+ * @param sim_world The engine's world; holds the final generation on return.
+ * @param width Total number of columns
+ * @param height Total number of rows
+ * @param opts The simulation options.
+ *
+ * @return The wall time of the simulation itself, in seconds.
+ */
+static double run_engine(const Engine *engine, void *sim_world, int width, int height, const SimOptions *opts) {
+	struct timespec start, end;
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	run_threads(engine, sim_world, width, height, opts);
+	clock_gettime(CLOCK_MONOTONIC, &end);
+
+	return (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+}
+
+/**
+ * The region of a HashLife world that is simulated, for count_region.
+ */
+typedef struct HashLifeRegion {
+	HashLife *hl;
+	int col;	// the column of the region's top-left cell
+	int row;	// the row of the region's top-left cell
+} HashLifeRegion;
+
+/**
+ * Counts the live cells of a block of a HashLifeRegion, so it can be shown
+ * through a Viewport like the worlds of the engines.
+ */
+static int64_t count_region(const void *world, int col, int row, int num_cols, int num_rows) {
+	const HashLifeRegion *region = world;
+	return hashlife_region_count(region->hl, region->col + col, region->row + row, num_cols, num_rows);
+}
+
+/**
+ * Simulates the world with the HashLife engine, on a single thread. When
+ * rendering, the world is advanced one generation at a time and printed
+ * whenever a frame is due; otherwise all turns are done at once, in
+ * power-of-two jumps.
+ *
+ * @param region The region of the world to simulate (and show).
+ * @param world If not NULL, receives the cells of the region at the end.
+ * @param width Width of the region
+ * @param height Height of the region
+ * @param opts The simulation options (num_threads is ignored).
+ * @param view If not NULL, the part of the region to print as it is
+ *   simulated, moved for the keys typed meanwhile.
+ * @param delay The ms between frames when rendering.
+ *
+ * @return The wall time of the simulation itself, in seconds.
+ */
+static double run_hashlife(HashLifeRegion *region, int *world, int width, int height,
+		const SimOptions *opts, Viewport *view, int delay) {
+	HashLife *hl = region->hl;
+	struct timespec start, end;
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	if (view != NULL) {
+		nodelay(stdscr, TRUE);
+		double due = delay / 1000.0;	// seconds from start to the next frame
+		for (int turn_number = 1; turn_number <= opts->num_turns; turn_number++) {
+			hashlife_step(hl, 1);
+			clock_gettime(CLOCK_MONOTONIC, &end);
+			double now = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+			if (now >= due && turn_number < opts->num_turns) {
+				int key;
+				while ((key = getch()) != ERR) {
+					if (!viewport_key(view, key, width, height)) {
+						ungetch(key);
+						break;
+					}
+				}
+				viewport_draw(view, count_region, region, width, height, turn_number);
+				due = (due + delay / 1000.0 > now) ? due + delay / 1000.0 : now;
+			}
+		}
+		nodelay(stdscr, FALSE);
+	}
+	else {
+		hashlife_step(hl, opts->num_turns);
+	}
+	clock_gettime(CLOCK_MONOTONIC, &end);
+
+	if (world != NULL) {
+		hashlife_region_to_cells(hl, world, region->col, region->row, width, height);
+	}
+	return (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+}
+
+/**
+ * Returns true if a file name ends with the given extension.
+ */
+static bool has_extension(const char *filename, const char *ext) {
+	size_t name_len = strlen(filename), ext_len = strlen(ext);
+	return name_len > ext_len && strcmp(filename + name_len - ext_len, ext) == 0;
+}
+
+/**
+ * Saves the final world, as a macrocell pattern if the file name ends in
+ * ".mc" and as RLE otherwise. Prints what went wrong if it could not.
+ *
+ * @param filename The name of the file to write.
+ * @param hl The world as a quadtree, or NULL to build one from the cells.
+ * @param world The cells of the world (NULL if hl is given and the file
+ *   is a macrocell file).
+ * @param width Total number of columns
+ * @param height Total number of rows
+ * @param rule The rule the world was simulated with.
+ *
+ * @return 0 on success, -1 on failure.
+ */
+static int save_world(const char *filename, HashLife *hl, int *world, int width, int height,
+		const char *rule) {
+	if (!has_extension(filename, ".mc")) {
+		if (rle_write(filename, world, width, height, rule) != 0) {
+			perror(filename);
+			return -1;
+		}
+		return 0;
+	}
+
+	HashLife *tree = (hl != NULL) ? hl : hashlife_from_cells(world, width, height);
+	if (tree == NULL) {
+		fprintf(stderr, "Saving a .mc file needs a world whose width and height are powers of two.\n");
+		return -1;
+	}
+	int ret = hashlife_write_mc(tree, filename, rule);
+	if (ret != 0) {
+		perror(filename);
+	}
+	if (tree != hl) {
+		hashlife_free(tree);
+	}
+	return ret;
+}
+
+/**
+ * Writes a checkpoint of the final world. Prints what went wrong if it
+ * could not.
+ *
+ * @param filename The name of the checkpoint file.
+ * @param bw The world, if it is bit-packed, or NULL to pack the cells.
+ * @param world The cells of the world (only used if bw is NULL).
+ * @param width Total number of columns
+ * @param height Total number of rows
+ * @param generation The generation the world is at.
+ * @param rule The rule the world was simulated with.
+ *
+ * @return 0 on success, -1 on failure.
+ */
+static int save_checkpoint(const char *filename, BitWorld *bw, int *world, int width, int height,
+		uint64_t generation, const char *rule) {
+	BitWorld *packed = (bw != NULL) ? bw : bitworld_from_cells(world, width, height);
+	if (packed == NULL) {
+		fprintf(stderr, "Error allocating the checkpoint.\n");
+		return -1;
+	}
+	int ret = checkpoint_write(filename, packed, generation, rule);
+	if (ret != 0) {
+		perror(filename);
+	}
+	if (packed != bw) {
+		bitworld_free(packed);
+	}
+	return ret;
+}
+
+/**
+ * Allocates an int-per-cell world, or returns NULL if it could not be
+ * allocated or is too large to index.
+ */
+static int *alloc_cells(int width, int height) {
+	if (!world_fits(width, height)) {
+		return NULL;
+	}
+	return malloc(world_size(width, height) * sizeof(int));
+}
+
 /*
  * Main function to run parallel game of life simulation
  *
@@ -57,37 +229,98 @@ int main(int argc, char *argv[]) {
 	// Step 1: Parse command line args 
 	char *config_filename = NULL;
 
-	int delay = 100; // default value for delay between turns is 100
+	int delay = 100; // default to a frame every 100 ms
 	int num_turns = 20; // default to 20 turns per simulation
 	char ch;
 	int p = 1; //default value for p is 1
 	int num_threads = 2; //default value for num_threads is 2
+	bool use_bits = true; //default to the bit-packed world
+	bool use_bytes = false; //rather than the byte-per-cell world
+	bool use_hashlife = false; //rather than the HashLife quadtree
+	char *kernel = "auto"; //with the widest kernel this CPU supports
+	bool headless = false; //default to showing the simulation
+	int block_turns = 1; //generations computed per visit of a tile
+	bool pin_threads = false; //leave thread placement to the OS
+	char *output_filename = NULL; //where to save the final world, if anywhere
+	int region[4] = {0, 0, 0, 0}; //part of a .mc pattern to expand, 0x0 for all
+	char *checkpoint_filename = NULL; //where to checkpoint the final world
+	int checkpoint_every = 0; //and every so many generations before it, if not 0
+	bool verify_checkpoint = false; //check a restored checkpoint's checksum
+	Rule rule = RULE_LIFE; //the rule to simulate
+	bool rule_given = false; //with -R, rather than the pattern's own
 
 	// reads from the argument line assigniing -c, -t, -d, and -p or sets them
 	// to default if no user entry
-	while ((ch = getopt(argc, argv, "c:t:d:p:")) != -1) {
+	while ((ch = getopt(argc, argv, "c:t:d:p:k:b:qao:r:w:e:vR:")) != -1) {
 		switch (ch) {
 			case 'c':
 				config_filename = optarg;
 				break;
 			case 't':
-				if (sscanf(optarg, "%d", &num_turns) != 1) {
+				if (sscanf(optarg, "%d", &num_turns) != 1 || num_turns < 0) {
 					fprintf(stderr, "Invalid value for -t: %s\n", optarg);
 					usage(argv[0]);
 				}
 				break;
 			case 'd':
-				if (sscanf(optarg, "%d", &delay) != 1) {
+				if (sscanf(optarg, "%d", &delay) != 1 || delay < 0) {
 					fprintf(stderr, "Invalid value for -d: %s\n", optarg);
 					usage(argv[0]);
 				}
 				break;
 			case 'p':
-				if (sscanf(optarg, "%d", &num_threads) != 1){
+				if (sscanf(optarg, "%d", &num_threads) != 1 || num_threads < 1){
 					fprintf(stderr, "Invalid value for -p: %s\n", optarg);
 					usage(argv[0]);
 				}
 				break;
+			case 'k':
+				use_hashlife = (strcmp(optarg, "hashlife") == 0);
+				use_bytes = (strcmp(optarg, "byte") == 0);
+				use_bits = (strcmp(optarg, "int") != 0 && !use_bytes && !use_hashlife);
+				kernel = optarg;
+				break;
+			case 'b':
+				if (sscanf(optarg, "%d", &block_turns) != 1 || block_turns < 1 || block_turns > 64) {
+					fprintf(stderr, "Invalid value for -b (1 to 64): %s\n", optarg);
+					usage(argv[0]);
+				}
+				break;
+			case 'q':
+				headless = true;
+				break;
+			case 'a':
+				pin_threads = true;
+				break;
+			case 'o':
+				output_filename = optarg;
+				break;
+			case 'w':
+				checkpoint_filename = optarg;
+				break;
+			case 'e':
+				if (sscanf(optarg, "%d", &checkpoint_every) != 1 || checkpoint_every < 1) {
+					fprintf(stderr, "Invalid value for -e: %s\n", optarg);
+					usage(argv[0]);
+				}
+				break;
+			case 'v':
+				verify_checkpoint = true;
+				break;
+			case 'r':
+				if (sscanf(optarg, "%d,%d,%d,%d", &region[0], &region[1], &region[2], &region[3]) != 4
+						|| region[0] < 0 || region[1] < 0 || region[2] < 1 || region[3] < 1) {
+					fprintf(stderr, "Invalid value for -r: %s\n", optarg);
+					usage(argv[0]);
+				}
+				break;
+			case 'R':
+				if (rule_parse(optarg, &rule) != 0) {
+					fprintf(stderr, "Invalid value for -R: %s\n", optarg);
+					usage(argv[0]);
+				}
+				rule_given = true;
+				break;
 			default:
 				usage(argv[0]);
 		}
@@ -99,170 +332,286 @@ int main(int argc, char *argv[]) {
 		usage(argv[0]);
 	}
 
+	// periodic checkpoints are taken by the threads of the flat engines
+	if (checkpoint_every > 0 && (checkpoint_filename == NULL || use_hashlife)) {
+		fprintf(stderr, "-e needs -w and a kernel other than hashlife\n");
+		usage(argv[0]);
+	}
+
+	// pick the bit-packed kernel before any thread uses it
+	if (use_bits && bitworld_select_kernel(kernel) != 0) {
+		fprintf(stderr, "Unknown or unsupported kernel for -k: %s\n", kernel);
+		usage(argv[0]);
+	}
+
 	// Print summary of simulation options
 	fprintf(stdout, "Config Filename: %s\n", config_filename);
 	fprintf(stdout, "Number of turns: %d\n", num_turns);
-	fprintf(stdout, "Delay between turns: %d ms\n", delay);
+	fprintf(stdout, "Time between frames: %d ms\n", delay);
 	fprintf(stdout, "Parallelism: %d\n", p);
 	fprintf(stdout, "Num threads: %d\n", num_threads);
-	// Step 2: Set up the text-based ncurses UI window.
-	initscr(); 	// initialize screen
-	cbreak(); 	// set mode that allows user input to be immediately available
-	noecho(); 	// don't print the characters that the user types in
-	clear();  	// clears the window
+	fprintf(stdout, "Kernel: %s\n", use_bits ? bitworld_kernel_name() : kernel);
+	fprintf(stdout, "Generations per tile visit: %d\n", block_turns);
+	fprintf(stdout, "Pinned threads: %s\n", pin_threads ? "yes" : "no");
+	fprintf(stdout, "Headless: %s\n", headless ? "yes" : "no");
+	if (rule_given) {
+		char rule_name[32];
+		rule_format(&rule, rule_name, sizeof(rule_name));
+		fprintf(stdout, "Rule: %s\n", rule_name);
+	}
+	else {
+		fprintf(stdout, "Rule: from the pattern\n");
+	}
+	// Step 2: Set up the text-based ncurses UI window, unless running
+	// headless (no rendering, for throughput measurements).
+	if (!headless) {
+		initscr(); 	// initialize screen
+		cbreak(); 	// set mode that allows user input to be immediately available
+		noecho(); 	// don't print the characters that the user types in
+		clear();  	// clears the window
+		keypad(stdscr, TRUE);	// arrow keys move the view
+	}
 
 
 	// Step 3: Create and initialze the world.
 	int width, height;
-	//creates initial world graph
-	int *world = initialize_world(config_filename, &width, &height);
+	int *world = NULL;
+	HashLife *hl = NULL;
+	BitWorld *restored = NULL; //a checkpoint, simulated where it is mapped
+	uint64_t generation = 0; //generation the world starts at
+	Rule pattern_rule = RULE_LIFE; //the rule the world was loaded with
+	// cells are needed to save or convert a world that is loaded some other
+	// way; the world is shown from whatever it is simulated as
+	bool need_cells = (output_filename != NULL && !has_extension(output_filename, ".mc"))
+			|| (use_hashlife && checkpoint_filename != NULL);
+	if (has_extension(config_filename, ".mc")) {
+		// a macrocell pattern is read as a quadtree, and only the region that
+		// is simulated (or, with HashLife, shown or saved) becomes cells
+		char rule_text[64];
+		hl = hashlife_read_mc(config_filename, &width, &height, rule_text, sizeof(rule_text));
+		if (hl != NULL && rule_parse(rule_text, &pattern_rule) != 0) {
+			fprintf(stderr, "Unsupported rule: %s\n", rule_text);
+			hashlife_free(hl);
+			hl = NULL;
+		}
+		if (region[2] == 0) {
+			region[2] = width;
+			region[3] = height;
+		}
+		width = region[2];
+		height = region[3];
 
-	if (world == NULL) {
-		endwin();
-		fprintf(stderr, "Error initializing the world.\n");
-		exit(1);
+		if (hl != NULL && (need_cells || !use_hashlife)) {
+			world = alloc_cells(width, height);
+			if (world != NULL) {
+				hashlife_region_to_cells(hl, world, region[0], region[1], width, height);
+			}
+			else {
+				fprintf(stderr, "The region of the pattern is too large; pick a smaller one with -r.\n");
+				hashlife_free(hl);
+				hl = NULL;
+			}
+		}
+		if (!use_hashlife) {
+			hashlife_free(hl);
+			hl = NULL;
+		}
+	}
+	else if (region[2] != 0) {
+		fprintf(stderr, "-r only applies to .mc patterns\n");
+		usage(argv[0]);
+	}
+	else if (has_extension(config_filename, ".ckpt")) {
+		// a checkpoint is mapped as a bit-packed world, which only becomes
+		// cells if something needs them
+		char rule_text[64];
+		restored = checkpoint_map(config_filename, &generation, rule_text, sizeof(rule_text),
+				verify_checkpoint);
+		if (restored != NULL && rule_parse(rule_text, &pattern_rule) != 0) {
+			fprintf(stderr, "Unsupported rule: %s\n", rule_text);
+			bitworld_free(restored);
+			restored = NULL;
+		}
+		if (restored != NULL) {
+			width = restored->num_cols;
+			height = restored->num_rows;
+		}
+		if (restored != NULL && (need_cells || !use_bits)) {
+			world = alloc_cells(width, height);
+			if (world != NULL) {
+				bitworld_to_cells(restored, world);
+			}
+			else {
+				fprintf(stderr, "The checkpoint is too large to show or convert; run it with -q and a bit-packed kernel.\n");
+				bitworld_free(restored);
+				restored = NULL;
+			}
+		}
+		if (!use_bits) {
+			bitworld_free(restored);
+			restored = NULL;
+		}
+	}
+	else {
+		//creates initial world graph
+		world = initialize_world(config_filename, &width, &height, &pattern_rule);
 	}
-	// Step 4: Simulate for the required number of steps, printing the world
-	// after each step.
-
-
-	run_threads(num_threads, num_turns, world, width, height, delay);
-	print_world(world, width, height, num_turns); // print final world
-
-	// Step 5: Wait for the user to type a character before ending the
-	// program. Don't change anything below here.
-
-	// print message to the bottom of the screen (i.e. on the last line)
-	mvaddstr(LINES-1, 0, "Press any key to end the program.");
-
-	getch(); // wait for user to enter a key
-	endwin(); // close the ncurses UI window
-	free(world);//free the world memory
-	return 0;
-}
 
+	if (use_hashlife && hl == NULL && world != NULL) {
+		hl = hashlife_from_cells(world, width, height);
+		if (hl == NULL) {
+			if (!headless) {
+				endwin();
+			}
+			fprintf(stderr, "HashLife needs a world whose width and height are powers of two.\n");
+			exit(1);
+		}
+	}
 
-/*
- * This function uses barriers to synchronize multiple threads runnning the simulation
- * 
- * @param args The ThreadData struct which contains the parameters to the thread
- * function
- */
-void* thread_function(void* args){
-	ThreadData *myargs = (ThreadData*)args; //cast back to struct
-	int total_rows = (myargs->end_row) - (myargs->start_row) + 1; //calculate total rows
-	fprintf(stdout, "\rid %d: rows: %d:%d (%d)\n", myargs-> id, myargs-> start_row, myargs->end_row, total_rows);
-	//iterate through number of turns
-	for (int turn_number = 0; turn_number < myargs->num_turns; turn_number++) {
-		//wait for threads and check for errors
-		int bar = pthread_barrier_wait(myargs->barrier);
-		if(bar != 0 && bar != PTHREAD_BARRIER_SERIAL_THREAD){
-			perror("pthread_barrier_wait");
-			exit(EXIT_FAILURE);
-		}   
-		
-		//only the first thread prints and makes a copy of the world
-		if(myargs->id == 0){ 
-			for(int i = 0; i < myargs->width*myargs->height; i++){
-				myargs->world_copy[i] = myargs->world[i];
-			} 
-			print_world(myargs->world,myargs-> width, myargs->height, turn_number);
-        	usleep(1000 * myargs->delay);  //adds delay to see changes
-		}   
-		//wait for threads and check for errors
-		bar = pthread_barrier_wait(myargs->barrier);
-		if(bar != 0 && bar != PTHREAD_BARRIER_SERIAL_THREAD){
-			perror("pthread_barrier_wait");
-			exit(EXIT_FAILURE);
-		}   
-
-		update_world(myargs->world,myargs->world_copy, myargs->width, myargs->height, myargs->start_row, myargs->end_row);
-
-	}
-	return NULL;
-}
+	if (use_hashlife ? hl == NULL : (world == NULL && restored == NULL)) {
+		if (!headless) {
+			endwin();
+		}
+		fprintf(stderr, "Error initializing the world.\n");
+		exit(1);
+	}
+	if (!rule_given) {
+		rule = pattern_rule;
+	}
+	char rule_name[32]; //the rule, as it is recorded in the saved files
+	rule_format(&rule, rule_name, sizeof(rule_name));
+	// every thread needs a row of its own to start with
+	if (num_threads > height) {
+		num_threads = height;
+	}
+	// Step 4: Simulate for the required number of steps, printing the latest
+	// generation every frame. The simulation does not wait for the frames,
+	// so the generations in between are never shown.
 
 
-/*
- * Function that will create Pthread threads, initialize the ThreadData struct
- * passed in as a parameter for our thread_function, and determines start and
- * end row for individual threads.
- *
- * @param num_threads The number of threads completing the simulation
- * @param num_turns The number of simulation turns
- * @param *world The world
- * @param width Total number of columns
- * @param height Total number of rows
- * @param delay Delay between turns
- */
+	SimOptions opts = {
+		.num_threads = num_threads,
+		.num_turns = num_turns,
+		.verbose = true,
+		.turn_seconds = NULL,
+		.block_turns = block_turns,
+		.pin_threads = pin_threads,
+		.snapshots = {NULL},
+	};
 
-void run_threads(int num_threads, int num_turns, int *world, int width, int height, int delay){
-	int remainder = height % num_threads;
-	int cur = 0;
-	unsigned rows_per_thread = height/num_threads;
-
-	//creates a new struct
-	ThreadData *td = malloc(num_threads * sizeof(ThreadData));
-	//creates space for new pthread ids
-	pthread_t *tids = malloc(sizeof(pthread_t)*num_threads);
-	//creates space for a copy of the world
-	int *world_copy = malloc(width*height*sizeof(int));
-	pthread_barrier_t shared_barrier;
-	//inititalize barrier and check for errors
-	if (pthread_barrier_init(&shared_barrier, NULL, num_threads) != 0) {
-		perror("pthread_barrier_init");
-		exit(EXIT_FAILURE);
-	}
-	int start = 0, end = 0;   
-	//makes sure that a single row isn't split between multiple threads
-	//thread row dimensions differences is never greater than 1
-	for(int i=0; i < num_threads; i++){
-		if(remainder > 0) {
-			start = cur;
-			end = cur + rows_per_thread;
-			cur = end + 1;
-			remainder--;
+	double seconds;
+	const Engine *engine = use_bits ? &bit_engine : (use_bytes ? &byte_engine : &int_engine);
+	void *sim_world = NULL;
+	// the part of the world on the screen, and how to count its cells
+	Viewport view;
+	CountCells count = engine->count;
+	const void *shown_world = NULL;
+	HashLifeRegion shown_region = {hl, region[0], region[1]};
+	if (!headless) {
+		viewport_fit(&view, width, height);
+	}
+	if (use_hashlife) {
+		hashlife_set_rule(hl, &rule);
+		count = count_region;
+		shown_world = &shown_region;
+		if (!headless) {
+			viewport_draw(&view, count, shown_world, width, height, 0);
 		}
-		else{
-			start = cur;
-			end = cur + rows_per_thread - 1;
-			cur = end + 1;
-
+		seconds = run_hashlife(&shown_region, world, width, height, &opts, headless ? NULL : &view, delay);
+	}
+	else {
+		sim_world = (restored != NULL) ? restored : engine_from_cells(engine, world, width, height);
+		if (sim_world == NULL) {
+			if (!headless) {
+				endwin();
+			}
+			fprintf(stderr, "Error allocating the world.\n");
+			exit(1);
+		}
+		shown_world = sim_world;
+		engine->set_rule(&rule);
+		Checkpointer *checkpointer = NULL;
+		if (checkpoint_every > 0) {
+			checkpointer = checkpointer_create(checkpoint_filename, engine, width, height,
+					checkpoint_every, generation, rule_name);
+			if (checkpointer == NULL) {
+				if (!headless) {
+					endwin();
+				}
+				fprintf(stderr, "Error allocating the checkpoint buffers.\n");
+				exit(1);
+			}
+			opts.snapshots[0] = checkpointer_snapshots(checkpointer);
+		}
+		Renderer *renderer = NULL;
+		if (!headless) {
+			viewport_draw(&view, count, shown_world, width, height, 0);
+			renderer = renderer_create(engine, width, height, delay, &view);
+			if (renderer == NULL) {
+				endwin();
+				fprintf(stderr, "Error allocating the frame buffers.\n");
+				exit(1);
+			}
+			opts.snapshots[1] = renderer_snapshots(renderer);
+		}
+		seconds = run_engine(engine, sim_world, width, height, &opts);
+		if (renderer != NULL) {
+			renderer_free(renderer);
+		}
+		if (checkpointer != NULL && checkpointer_free(checkpointer) != 0) {
+			if (!headless) {
+				endwin();
+			}
+			perror(checkpoint_filename);
+			exit(1);
 		}
+		if (world != NULL) {
+			engine_to_cells(engine, sim_world, world, width, height);
+		}
+	}
+	generation += num_turns;
 
-		//these lines initialize the struct fields of the newly created struct
-		td[i].id = i;
-		td[i].num_turns = num_turns;
-		td[i].world = world;
-		td[i].width = width;
-		td[i].height = height;
-		td[i].delay =  delay;
-		td[i].barrier = &shared_barrier;
-		td[i].world_copy = world_copy;
-		td[i].start_row = start;
-		td[i].end_row = end;
-	}
-	//create threads and check for failure
-	for(int i = 0; i < num_threads; i++){
-		if(pthread_create(&tids[i], NULL, thread_function, &td[i]) != 0){
-			perror("pthread_create");
-			exit(EXIT_FAILURE);
+	// save the final world before anything waits for the user
+	bool saved = (output_filename == NULL || save_world(output_filename, hl, world, width, height, rule_name) == 0)
+			&& (checkpoint_filename == NULL || save_checkpoint(checkpoint_filename,
+					(sim_world != NULL && use_bits) ? sim_world : NULL, world, width, height, generation, rule_name) == 0);
+	if (!saved) {
+		if (!headless) {
+			endwin();
 		}
+		exit(1);
 	}
-	//join threads and check for failure
-	for(int i = 0; i < num_threads; i++){
-		if(pthread_join(tids[i], NULL) != 0){
-			perror("pthread_join");
-			exit(EXIT_FAILURE);
+	if (headless) {
+		fprintf(stdout, "Rule: %s\n", rule_name);
+		fprintf(stdout, "Total time: %.6f s\n", seconds);
+		fprintf(stdout, "Generations/sec: %.1f\n", num_turns / seconds);
+		fprintf(stdout, "Cell updates/sec: %.4g\n", (double)num_turns * width * height / seconds);
+		if (checkpoint_filename != NULL) {
+			fprintf(stdout, "Checkpoint: %s (generation %llu)\n", checkpoint_filename,
+					(unsigned long long)generation);
 		}
+		hashlife_free(hl);
+		if (sim_world != NULL) {
+			engine->destroy(sim_world);
+		}
+		free(world);
+		return 0;
 	}
 
-	if(pthread_barrier_destroy(&shared_barrier) != 0){
-		perror("pthread_barrier_destroy");
-		exit(EXIT_FAILURE);
-	}
-	free(world_copy);
-	free(tids);
-	free(td);
+	// Step 5: Print the final world and wait for the user to type a
+	// character before ending the program; the keys that move the view
+	// move it instead.
+	do {
+		viewport_draw(&view, count, shown_world, width, height, num_turns);
+		// print message to the bottom of the screen (i.e. on the last line)
+		mvaddstr(LINES-1, 0, "Press any key to end the program.");
+	} while (viewport_key(&view, getch(), width, height));
 
+	endwin(); // close the ncurses UI window
+	hashlife_free(hl);
+	if (sim_world != NULL) {
+		engine->destroy(sim_world);
+	}
+	free(world);//free the world memory
+	return 0;
 }
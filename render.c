@@ -0,0 +1,420 @@
+/**
+ * File: render.c
+ *
+ * Implementation of the Viewport, and of the Renderer: a thread that asks
+ * for a snapshot of the simulation whenever a frame is due and prints the
+ * part of it the Viewport shows.
+ */
+
+#define _XOPEN_SOURCE 600
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+#include <errno.h>
+#include <pthread.h>
+#include <time.h>
+#include <curses.h>
+
+#include "gol.h"
+#include "render.h"
+
+// characters for zoomed out blocks, from all dead to all alive
+static const char shades[] = ".:-=+*#%@";
+#define NUM_SHADES ((int)sizeof(shades) - 1)
+
+/*
+ * Returns the number of rows of the screen the world is shown on; below
+ * them are a blank line, the turn number and the prompt at the end.
+ */
+static int screen_rows(void) {
+	return (LINES > 4) ? LINES - 3 : 1;
+}
+
+/*
+ * Returns the number of columns of the screen.
+ */
+static int screen_cols(void) {
+	return (COLS > 1) ? COLS : 1;
+}
+
+/*
+ * Returns the least zoom at which all of the world fits on the screen.
+ */
+static int fit_zoom(int num_cols, int num_rows) {
+	int zoom_cols = (num_cols + screen_cols() - 1) / screen_cols();
+	int zoom_rows = (num_rows + screen_rows() - 1) / screen_rows();
+	int zoom = (zoom_cols > zoom_rows) ? zoom_cols : zoom_rows;
+	return (zoom > 1) ? zoom : 1;
+}
+
+/*
+ * Keeps a Viewport's zoom between 1 and the zoom that fits the world, and
+ * the screen inside the world.
+ */
+static void clamp_view(Viewport *view, int num_cols, int num_rows) {
+	int max_zoom = fit_zoom(num_cols, num_rows);
+	if (view->zoom > max_zoom) {
+		view->zoom = max_zoom;
+	}
+	if (view->zoom < 1) {
+		view->zoom = 1;
+	}
+
+	int64_t max_col = num_cols - (int64_t)screen_cols() * view->zoom;
+	int64_t max_row = num_rows - (int64_t)screen_rows() * view->zoom;
+	if (view->col > max_col) {
+		view->col = (max_col > 0) ? (int)max_col : 0;
+	}
+	if (view->row > max_row) {
+		view->row = (max_row > 0) ? (int)max_row : 0;
+	}
+	if (view->col < 0) {
+		view->col = 0;
+	}
+	if (view->row < 0) {
+		view->row = 0;
+	}
+}
+
+void viewport_fit(Viewport *view, int num_cols, int num_rows) {
+	view->col = 0;
+	view->row = 0;
+	view->zoom = fit_zoom(num_cols, num_rows);
+}
+
+/*
+ * Changes the zoom of a Viewport, keeping the cell at the center of the
+ * screen where it is.
+ */
+static void zoom_view(Viewport *view, int zoom, int num_cols, int num_rows) {
+	int64_t center_col = view->col + (int64_t)screen_cols() * view->zoom / 2;
+	int64_t center_row = view->row + (int64_t)screen_rows() * view->zoom / 2;
+	view->zoom = zoom;
+	clamp_view(view, num_cols, num_rows);
+	center_col -= (int64_t)screen_cols() * view->zoom / 2;
+	center_row -= (int64_t)screen_rows() * view->zoom / 2;
+	view->col = (center_col > 0) ? (center_col < num_cols ? (int)center_col : num_cols) : 0;
+	view->row = (center_row > 0) ? (center_row < num_rows ? (int)center_row : num_rows) : 0;
+	clamp_view(view, num_cols, num_rows);
+}
+
+bool viewport_key(Viewport *view, int key, int num_cols, int num_rows) {
+	int64_t step_cols = (int64_t)(screen_cols() > 4 ? screen_cols() / 4 : 1) * view->zoom;
+	int64_t step_rows = (int64_t)(screen_rows() > 4 ? screen_rows() / 4 : 1) * view->zoom;
+	int64_t col = view->col, row = view->row;
+
+	switch (key) {
+		case KEY_LEFT:
+		case 'h':
+			col -= step_cols;
+			break;
+		case KEY_RIGHT:
+		case 'l':
+			col += step_cols;
+			break;
+		case KEY_UP:
+		case 'k':
+			row -= step_rows;
+			break;
+		case KEY_DOWN:
+		case 'j':
+			row += step_rows;
+			break;
+		case '+':
+		case '=':
+			zoom_view(view, view->zoom / 2, num_cols, num_rows);
+			return true;
+		case '-':
+			zoom_view(view, (view->zoom < INT32_MAX / 2) ? view->zoom * 2 : view->zoom,
+					num_cols, num_rows);
+			return true;
+		case '0':
+			viewport_fit(view, num_cols, num_rows);
+			return true;
+		default:
+			return false;
+	}
+
+	view->col = (col > 0) ? (col < num_cols ? (int)col : num_cols) : 0;
+	view->row = (row > 0) ? (row < num_rows ? (int)row : num_rows) : 0;
+	clamp_view(view, num_cols, num_rows);
+	return true;
+}
+
+void viewport_rows(const Viewport *view, int num_rows, int *first_row, int *last_row) {
+	int64_t end = view->row + (int64_t)screen_rows() * view->zoom;
+	*first_row = view->row;
+	*last_row = (end < num_rows) ? (int)end - 1 : num_rows - 1;
+}
+
+// the characters on the screen (screen_rows() by screen_cols()), and what
+// they showed, so viewport_draw only redraws the ones that changed since
+static char *shown_chars = NULL;
+static char *line = NULL;	// the characters of the row being drawn
+static int shown_lines = 0;
+static int shown_cols = 0;
+static Viewport shown_view;
+static int shown_world_cols = 0;
+static int shown_world_rows = 0;
+
+void viewport_draw(const Viewport *view, CountCells count, const void *world, int num_cols,
+		int num_rows, int turn) {
+	int lines = screen_rows(), cols = screen_cols();
+	int zoom = view->zoom;
+
+	// anything but the world moving on starts over from a blank screen
+	bool redraw = (shown_chars == NULL || shown_lines != lines || shown_cols != cols
+			|| shown_view.col != view->col || shown_view.row != view->row
+			|| shown_view.zoom != zoom
+			|| shown_world_cols != num_cols || shown_world_rows != num_rows);
+	if (redraw) {
+		free(shown_chars);
+		free(line);
+		shown_chars = malloc((size_t)lines * cols);
+		line = malloc(cols);
+		if (shown_chars == NULL || line == NULL) {
+			perror("viewport_draw");
+			exit(EXIT_FAILURE);
+		}
+		shown_lines = lines;
+		shown_cols = cols;
+		shown_view = *view;
+		shown_world_cols = num_cols;
+		shown_world_rows = num_rows;
+		erase(); // blanks the screen without forcing a full repaint
+	}
+
+	// the characters that show some of the world
+	int64_t rows_left = ((int64_t)num_rows - view->row + zoom - 1) / zoom;
+	int64_t cols_left = ((int64_t)num_cols - view->col + zoom - 1) / zoom;
+	int used_lines = (rows_left < lines) ? (int)rows_left : lines;
+	int used_cols = (cols_left < cols) ? (int)cols_left : cols;
+
+	for (int y = 0; y < used_lines; y++) {
+		int row = view->row + y * zoom;
+		int height = (num_rows - row < zoom) ? num_rows - row : zoom;
+		for (int x = 0; x < used_cols; x++) {
+			int col = view->col + x * zoom;
+			int width = (num_cols - col < zoom) ? num_cols - col : zoom;
+			int64_t live = count(world, col, row, width, height);
+			if (zoom == 1) {
+				line[x] = live ? '@' : '.';
+			}
+			else {
+				// any live cell shows, and only a full block shows as full
+				int64_t area = (int64_t)width * height;
+				line[x] = shades[(live * (NUM_SHADES - 1) + area - 1) / area];
+			}
+		}
+
+		char *shown = shown_chars + (size_t)y * cols;
+		// most rows of a frame are the same as in the last one
+		if (!redraw && memcmp(line, shown, used_cols) == 0) {
+			continue;
+		}
+		for (int x = 0; x < used_cols; x++) {
+			if (redraw || line[x] != shown[x]) {
+				mvaddch(y, x, line[x]);
+			}
+		}
+		memcpy(shown, line, used_cols);
+	}
+
+	// print the turn number below the world, and where the screen is in it
+	// when that is not all of it
+	mvprintw(used_lines + 1, 0, "Time Step: %d", turn);
+	if (zoom > 1 || used_lines < rows_left || used_cols < cols_left || view->col > 0 || view->row > 0) {
+		printw("   (%d,%d) 1:%d  arrows/hjkl scroll, +/- zoom, 0 all", view->col, view->row, zoom);
+	}
+	clrtoeol();
+
+	refresh(); // displays the text we've added
+}
+
+struct Renderer {
+	SimSnapshots snapshots;	// arg points back to the Renderer
+	const Engine *engine;
+	int num_cols;
+	int num_rows;
+	int delay;
+	Viewport *view;
+	void *frame;	// the world the simulation copies a frame into
+	int first_row;	// the rows of the frame the Viewport shows
+	int last_row;
+	atomic_bool wanted;	// a frame is due and frame is free to fill
+	bool ready;	// frame holds a complete snapshot, not shown yet
+	int turn;	// of the snapshot in frame
+	int frames_shown;
+	pthread_t thread;
+	pthread_mutex_t lock;
+	pthread_cond_t wake;	// a frame is ready, or closing was set
+	bool closing;
+};
+
+/**
+ * Hands out the frame if one is due, or NULL to skip this snapshot. Called
+ * once per snapshot, which is every turn, so it does not take the lock.
+ */
+static void *renderer_acquire(void *arg, int turn, int *first_row, int *last_row) {
+	Renderer *r = arg;
+	(void)turn;
+
+	if (!atomic_load_explicit(&r->wanted, memory_order_relaxed)
+			|| !atomic_exchange(&r->wanted, false)) {
+		return NULL;
+	}
+	// only the rows on the screen are worth copying
+	*first_row = r->first_row;
+	*last_row = r->last_row;
+	return r->frame;
+}
+
+/**
+ * Wakes the thread up to show a complete frame.
+ */
+static void renderer_release(void *arg, void *world, int turn) {
+	Renderer *r = arg;
+	(void)world;
+
+	pthread_mutex_lock(&r->lock);
+	r->ready = true;
+	r->turn = turn;
+	pthread_cond_signal(&r->wake);
+	pthread_mutex_unlock(&r->lock);
+}
+
+/**
+ * Adds ms milliseconds to a time.
+ */
+static void add_ms(struct timespec *t, int ms) {
+	t->tv_sec += ms / 1000;
+	t->tv_nsec += (long)(ms % 1000) * 1000000;
+	if (t->tv_nsec >= 1000000000) {
+		t->tv_sec++;
+		t->tv_nsec -= 1000000000;
+	}
+}
+
+/**
+ * Returns true if time a is before time b.
+ */
+static bool time_before(const struct timespec *a, const struct timespec *b) {
+	return a->tv_sec < b->tv_sec || (a->tv_sec == b->tv_sec && a->tv_nsec < b->tv_nsec);
+}
+
+/**
+ * Body of the render thread: every delay ms, moves the Viewport for the
+ * keys typed since the last frame, asks for a frame, waits for the
+ * simulation to fill it and prints it, until the Renderer is closing.
+ */
+static void *renderer_thread(void *arg) {
+	Renderer *r = arg;
+	struct timespec due;	// when the next frame is due
+	clock_gettime(CLOCK_MONOTONIC, &due);
+	add_ms(&due, r->delay);
+
+	pthread_mutex_lock(&r->lock);
+	while (!r->closing) {
+		if (pthread_cond_timedwait(&r->wake, &r->lock, &due) != ETIMEDOUT) {
+			continue;
+		}
+
+		int key;
+		// any other key is left for the prompt at the end
+		while ((key = getch()) != ERR) {
+			if (!viewport_key(r->view, key, r->num_cols, r->num_rows)) {
+				ungetch(key);
+				break;
+			}
+		}
+		viewport_rows(r->view, r->num_rows, &r->first_row, &r->last_row);
+
+		// only the simulation touches the frame from here until it is ready
+		atomic_store(&r->wanted, true);
+		while (!r->ready && !r->closing) {
+			pthread_cond_wait(&r->wake, &r->lock);
+		}
+		if (!r->ready) {
+			break;
+		}
+		int turn = r->turn;
+		pthread_mutex_unlock(&r->lock);
+
+		viewport_draw(r->view, r->engine->count, r->frame, r->num_cols, r->num_rows, turn);
+
+		// keep to the display rate, unless printing fell behind it
+		struct timespec now;
+		clock_gettime(CLOCK_MONOTONIC, &now);
+		add_ms(&due, r->delay);
+		if (time_before(&due, &now)) {
+			due = now;
+		}
+
+		pthread_mutex_lock(&r->lock);
+		r->ready = false;
+		r->frames_shown++;
+	}
+	pthread_mutex_unlock(&r->lock);
+	return NULL;
+}
+
+Renderer *renderer_create(const Engine *engine, int num_cols, int num_rows, int delay, Viewport *view) {
+	Renderer *r = calloc(1, sizeof(Renderer));
+	if (r == NULL) {
+		return NULL;
+	}
+
+	r->snapshots.every = 1;
+	r->snapshots.acquire = renderer_acquire;
+	r->snapshots.release = renderer_release;
+	r->snapshots.arg = r;
+	r->engine = engine;
+	r->num_cols = num_cols;
+	r->num_rows = num_rows;
+	r->delay = delay;
+	r->view = view;
+	atomic_init(&r->wanted, false);
+	r->frame = engine->create(num_cols, num_rows);
+	if (r->frame == NULL) {
+		free(r);
+		return NULL;
+	}
+
+	// timed waits are against the monotonic clock, like the frame times
+	pthread_condattr_t attr;
+	pthread_condattr_init(&attr);
+	pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+	pthread_mutex_init(&r->lock, NULL);
+	pthread_cond_init(&r->wake, &attr);
+	pthread_condattr_destroy(&attr);
+	// keys are read between frames, without waiting for any
+	nodelay(stdscr, TRUE);
+	if (pthread_create(&r->thread, NULL, renderer_thread, r) != 0) {
+		perror("pthread_create");
+		exit(EXIT_FAILURE);
+	}
+	return r;
+}
+
+const SimSnapshots *renderer_snapshots(Renderer *r) {
+	return &r->snapshots;
+}
+
+int renderer_free(Renderer *r) {
+	pthread_mutex_lock(&r->lock);
+	r->closing = true;
+	pthread_cond_signal(&r->wake);
+	pthread_mutex_unlock(&r->lock);
+	pthread_join(r->thread, NULL);
+	nodelay(stdscr, FALSE);
+
+	int frames_shown = r->frames_shown;
+	r->engine->destroy(r->frame);
+	pthread_mutex_destroy(&r->lock);
+	pthread_cond_destroy(&r->wake);
+	free(r);
+	return frames_shown;
+}
@@ -0,0 +1,127 @@
+#ifndef __RENDER_H__
+#define __RENDER_H__
+/**
+ * File: render.h
+ *
+ * Shows the world with ncurses through a Viewport, which scrolls over
+ * worlds larger than the terminal and zooms out to show a block of cells
+ * per character, so a frame costs as much as the part of the world it
+ * shows rather than the whole world.
+ *
+ * A Renderer shows a running simulation without slowing it down: its
+ * thread wakes up at the display rate and asks the simulation for its next
+ * generation, which the simulating threads copy into a spare world as they
+ * finish it (see SimSnapshots). The generations in between are never copied
+ * or shown, so the simulation runs as fast as it would without the display.
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "sim.h"
+
+/**
+ * The part of the world on the screen. Each character shows a zoom by zoom
+ * block of cells: '@' or '.' for a single live or dead cell, and otherwise
+ * one of ".:-=+*#%@" by the share of the block that is alive.
+ */
+typedef struct Viewport {
+	int col;	// column of the top-left cell on the screen
+	int row;	// row of the top-left cell on the screen
+	int zoom;	// cells per character on each side, at least 1
+} Viewport;
+
+/**
+ * Counts the live cells of a num_cols by num_rows block of a world whose
+ * top-left cell is (col, row), like Engine.count.
+ */
+typedef int64_t (*CountCells)(const void *world, int col, int row, int num_cols, int num_rows);
+
+/**
+ * Sets a Viewport to show all of the world, zoomed out as little as that
+ * takes on this terminal.
+ *
+ * @param view The Viewport to set.
+ * @param num_cols The width of the world.
+ * @param num_rows The height of the world.
+ */
+void viewport_fit(Viewport *view, int num_cols, int num_rows);
+
+/**
+ * Moves a Viewport for a key the user typed: the arrow keys (or h, j, k
+ * and l) scroll by a quarter of the screen, + and - zoom in and out around
+ * the center of the screen, and 0 shows the whole world again.
+ *
+ * @param view The Viewport to move.
+ * @param key The key, as returned by getch.
+ * @param num_cols The width of the world.
+ * @param num_rows The height of the world.
+ *
+ * @return true if the key is one of those keys, false otherwise.
+ */
+bool viewport_key(Viewport *view, int key, int num_cols, int num_rows);
+
+/**
+ * Returns the rows of the world a Viewport shows.
+ *
+ * @param view The Viewport.
+ * @param num_rows The height of the world.
+ * @param first_row Location where to store the first row shown.
+ * @param last_row Location where to store the last row shown.
+ */
+void viewport_rows(const Viewport *view, int num_rows, int *first_row, int *last_row);
+
+/**
+ * Prints the part of a world a Viewport shows, and the turn number below
+ * it. Only the characters that changed since the last call are redrawn,
+ * unless the Viewport or the terminal changed.
+ *
+ * @param view The part of the world to show.
+ * @param count Counts the live cells of a block of the world.
+ * @param world The world to print, as passed to count.
+ * @param num_cols The width of the world.
+ * @param num_rows The height of the world.
+ * @param turn The current turn number.
+ */
+void viewport_draw(const Viewport *view, CountCells count, const void *world, int num_cols,
+		int num_rows, int turn);
+
+/**
+ * Shows snapshots of a running simulation through a Viewport.
+ */
+typedef struct Renderer Renderer;
+
+/**
+ * Starts a Renderer. ncurses must be set up already; nothing else may use
+ * it, or the Viewport, until the Renderer is freed. The Renderer reads the
+ * keys typed in the meantime and moves the Viewport for them.
+ *
+ * @param engine The engine of the simulated world.
+ * @param num_cols The width of the world.
+ * @param num_rows The height of the world.
+ * @param delay The ms between frames, or 0 to show frames as fast as the
+ *   terminal takes them.
+ * @param view The part of the world to show.
+ *
+ * @return The new Renderer, or NULL if it could not be allocated.
+ */
+Renderer *renderer_create(const Engine *engine, int num_cols, int num_rows, int delay, Viewport *view);
+
+/**
+ * Returns the snapshot callbacks to put in the SimOptions of the simulation.
+ *
+ * @param r The Renderer.
+ */
+const SimSnapshots *renderer_snapshots(Renderer *r);
+
+/**
+ * Stops the Renderer, once it is done with the frame it is showing, and
+ * frees it.
+ *
+ * @param r The Renderer to free.
+ *
+ * @return The number of frames shown.
+ */
+int renderer_free(Renderer *r);
+
+#endif
@@ -0,0 +1,306 @@
+/**
+ * File: rle.c
+ *
+ * Reader and writer for RLE patterns. The reader loads the whole file and
+ * walks it with a pointer, rather than going through stdio one token at a
+ * time, since large patterns are millions of runs.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <ctype.h>
+#include <stdbool.h>
+
+#include "gol.h"
+#include "rle.h"
+
+// longest line the writer produces, as recommended by the format
+#define RLE_LINE_LENGTH 70
+
+/*
+ * Reads a whole file into a NUL-terminated buffer, or returns NULL if it
+ * could not be read.
+ */
+static char *read_file(const char *filename) {
+	FILE *file = fopen(filename, "rb");
+	if (file == NULL) {
+		return NULL;
+	}
+
+	char *text = NULL;
+	long size;
+	if (fseek(file, 0, SEEK_END) == 0 && (size = ftell(file)) >= 0
+			&& fseek(file, 0, SEEK_SET) == 0) {
+		text = malloc(size + 1);
+		if (text != NULL && fread(text, 1, size, file) == (size_t)size) {
+			text[size] = '\0';
+		}
+		else {
+			free(text);
+			text = NULL;
+		}
+	}
+
+	fclose(file);
+	return text;
+}
+
+/*
+ * Skips spaces and tabs (but not line ends).
+ */
+static const char *skip_blanks(const char *p) {
+	while (*p == ' ' || *p == '\t' || *p == '\r') {
+		p++;
+	}
+	return p;
+}
+
+/*
+ * Parses a positive number at *p, moving *p past it. Returns -1 if there is
+ * no number there or it does not fit in an int.
+ */
+static int parse_number(const char **p) {
+	const char *s = *p;
+	long value = 0;
+	if (!isdigit((unsigned char)*s)) {
+		return -1;
+	}
+	while (isdigit((unsigned char)*s)) {
+		value = value * 10 + (*s++ - '0');
+		if (value > 1 << 30) {
+			return -1;
+		}
+	}
+	*p = s;
+	return (int)value;
+}
+
+/*
+ * Parses the "x = <cols>, y = <rows>[, rule = <rule>]" header line at *p,
+ * moving *p to the start of the next line. Returns false if it is not a
+ * valid header.
+ */
+static bool parse_header(const char **p, int *num_cols, int *num_rows, char *rule, size_t rule_size) {
+	const char *s = *p;
+	*num_cols = *num_rows = -1;
+
+	while (*s != '\n' && *s != '\0') {
+		s = skip_blanks(s);
+		const char *key = s;
+		while (isalpha((unsigned char)*s)) {
+			s++;
+		}
+		size_t key_len = s - key;
+		s = skip_blanks(s);
+		if (key_len == 0 || *s++ != '=') {
+			return false;
+		}
+		s = skip_blanks(s);
+
+		if (key_len == 1 && (*key == 'x' || *key == 'y')) {
+			int value = parse_number(&s);
+			if (value <= 0) {
+				return false;
+			}
+			*(*key == 'x' ? num_cols : num_rows) = value;
+		}
+		else if (key_len == 4 && strncmp(key, "rule", 4) == 0) {
+			// the rule runs up to the end of the line, minus trailing blanks
+			const char *start = s;
+			while (*s != '\n' && *s != '\0' && *s != ',') {
+				s++;
+			}
+			size_t len = s - start;
+			while (len > 0 && isspace((unsigned char)start[len - 1])) {
+				len--;
+			}
+			if (len >= rule_size) {
+				len = rule_size - 1;
+			}
+			memcpy(rule, start, len);
+			rule[len] = '\0';
+		}
+		else {
+			// some other key (e.g. Golly's) that we have no use for
+			while (*s != '\n' && *s != '\0' && *s != ',') {
+				s++;
+			}
+		}
+
+		s = skip_blanks(s);
+		if (*s == ',') {
+			s++;
+		}
+		else if (*s != '\n' && *s != '\0') {
+			return false;
+		}
+	}
+
+	*p = (*s == '\n') ? s + 1 : s;
+	return *num_cols > 0 && *num_rows > 0;
+}
+
+int *rle_read(const char *filename, int *num_cols, int *num_rows, char *rule, size_t rule_size) {
+	char *text = read_file(filename);
+	if (text == NULL) {
+		return NULL;
+	}
+
+	// skip the comment lines before the header
+	const char *p = text;
+	for (;;) {
+		p = skip_blanks(p);
+		if (*p == '#' || *p == '\n') {
+			while (*p != '\n' && *p != '\0') {
+				p++;
+			}
+			if (*p == '\n') {
+				p++;
+			}
+			continue;
+		}
+		break;
+	}
+
+	snprintf(rule, rule_size, "B3/S23");
+	if (!parse_header(&p, num_cols, num_rows, rule, rule_size)) {
+		free(text);
+		return NULL;
+	}
+
+	// the header allows sizes whose int world would not fit
+	if (!world_fits(*num_cols, *num_rows)) {
+		fprintf(stderr, "%s: a %dx%d world is too large\n", filename, *num_cols, *num_rows);
+		free(text);
+		return NULL;
+	}
+	int *world = calloc(world_size(*num_cols, *num_rows), sizeof(int));
+	if (world == NULL) {
+		free(text);
+		return NULL;
+	}
+
+	unsigned stride = *num_cols + 2;
+	int row = 0, col = 0;
+	int run = 0;	// count of the run being read, 0 if none was given
+	bool ok = true;
+	for (; *p != '!' && ok; p++) {
+		char c = *p;
+		if (c >= '0' && c <= '9') {
+			run = run * 10 + (c - '0');
+			ok = (run <= 1 << 30);
+			continue;
+		}
+		if (c == ' ' || c == '\t' || c == '\r' || c == '\n') {
+			continue;
+		}
+
+		int n = (run > 0) ? run : 1;
+		run = 0;
+		// runs may end at the edge of the world but not go past it
+		if (c == 'b' || c == '.') {
+			if (n > *num_cols - col) {
+				ok = false;
+				break;
+			}
+			col += n;
+		}
+		else if (c == '$') {
+			if (n > *num_rows - row) {
+				ok = false;
+				break;
+			}
+			row += n;
+			col = 0;
+		}
+		else if (isalpha((unsigned char)c)) {
+			// 'o', or a state letter of a multi-state pattern: all alive
+			if (row >= *num_rows || n > *num_cols - col) {
+				ok = false;
+				break;
+			}
+			int *cells = world + (row + 1) * stride + col + 1;
+			for (int i = 0; i < n; i++) {
+				cells[i] = 1;
+			}
+			col += n;
+		}
+		else {
+			// a stray character, or the end of the file without a '!'
+			ok = false;
+		}
+	}
+
+	free(text);
+	if (!ok) {
+		free(world);
+		return NULL;
+	}
+
+	update_halo(world, *num_cols, *num_rows, 0, *num_rows - 1);
+	return world;
+}
+
+/*
+ * Writes a run of n cells (or row ends) with the given tag, starting a new
+ * line first if this one would get too long.
+ *
+ * @param file The file to write.
+ * @param n The length of the run.
+ * @param tag 'b', 'o', '$' or '!'.
+ * @param line_len The length of the current line, updated.
+ */
+static void write_run(FILE *file, int n, char tag, int *line_len) {
+	char item[16];
+	int len = (n > 1) ? snprintf(item, sizeof(item), "%d%c", n, tag)
+					  : snprintf(item, sizeof(item), "%c", tag);
+	if (*line_len + len > RLE_LINE_LENGTH) {
+		fputc('\n', file);
+		*line_len = 0;
+	}
+	fputs(item, file);
+	*line_len += len;
+}
+
+int rle_write(const char *filename, const int *world, int num_cols, int num_rows, const char *rule) {
+	FILE *file = fopen(filename, "w");
+	if (file == NULL) {
+		return -1;
+	}
+
+	fprintf(file, "x = %d, y = %d, rule = %s\n", num_cols, num_rows, rule);
+
+	unsigned stride = num_cols + 2;
+	int line_len = 0;
+	int cursor_row = 0;	// row the last run ended on
+	for (int row = 0; row < num_rows; row++) {
+		const int *cells = world + (row + 1) * stride + 1;
+		// dead cells at the end of a row are left out
+		int end = num_cols;
+		while (end > 0 && cells[end - 1] == 0) {
+			end--;
+		}
+		if (end == 0) {
+			continue;
+		}
+
+		if (row > cursor_row) {
+			write_run(file, row - cursor_row, '$', &line_len);
+			cursor_row = row;
+		}
+		for (int col = 0; col < end; ) {
+			int alive = cells[col];
+			int n = 1;
+			while (col + n < end && cells[col + n] == alive) {
+				n++;
+			}
+			write_run(file, n, alive ? 'o' : 'b', &line_len);
+			col += n;
+		}
+	}
+	write_run(file, 1, '!', &line_len);
+	fputc('\n', file);
+
+	return (fclose(file) == 0) ? 0 : -1;
+}
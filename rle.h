@@ -0,0 +1,44 @@
+#ifndef __RLE_H__
+#define __RLE_H__
+/**
+ * File: rle.h
+ *
+ * Reader and writer for the run-length encoded (RLE) pattern format used by
+ * most Life software. A pattern is an "x = <cols>, y = <rows>" header line
+ * (optionally followed by ", rule = <rule>") and then runs of cells: "<n>b"
+ * for n dead cells, "<n>o" for n live ones and "<n>$" to end n rows, up to a
+ * final "!". Lines starting with '#' are comments.
+ */
+
+#include <stddef.h>
+
+/**
+ * Reads an RLE pattern into a world like the ones initialize_world returns.
+ * The world is as large as the pattern's x and y.
+ *
+ * @param filename The name of the RLE file.
+ * @param num_cols Location where to store the width of the world.
+ * @param num_rows Location where to store the height of the world.
+ * @param rule Location where to store the rule of the pattern ("B3/S23" if
+ *   it has none), truncated to rule_size - 1 characters.
+ * @param rule_size The size of rule.
+ *
+ * @return The new world, or NULL if the file could not be read or is not a
+ *   valid pattern.
+ */
+int *rle_read(const char *filename, int *num_cols, int *num_rows, char *rule, size_t rule_size);
+
+/**
+ * Writes a world as an RLE pattern, with x and y the size of the world.
+ *
+ * @param filename The name of the file to write.
+ * @param world The world to write.
+ * @param num_cols The width of the world.
+ * @param num_rows The height of the world.
+ * @param rule The rule to record in the header.
+ *
+ * @return 0 on success, -1 if the file could not be written.
+ */
+int rle_write(const char *filename, const int *world, int num_cols, int num_rows, const char *rule);
+
+#endif
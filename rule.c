@@ -0,0 +1,94 @@
+/**
+ * File: rule.c
+ *
+ * Parsing and printing of rules in B/S notation.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <ctype.h>
+
+#include "rule.h"
+
+/**
+ * Parses a run of neighbor counts (digits 0 to 8) at *p into a mask, and
+ * moves *p past it.
+ *
+ * @return 0 on success, -1 if a count is out of range or repeated.
+ */
+static int parse_counts(const char **p, uint16_t *mask) {
+	*mask = 0;
+	while (isdigit((unsigned char)**p)) {
+		int n = **p - '0';
+		if (n > 8 || (*mask & (1 << n))) {
+			return -1;
+		}
+		*mask |= 1 << n;
+		(*p)++;
+	}
+	return 0;
+}
+
+int rule_parse(const char *text, Rule *rule) {
+	const char *p = text;
+	const char *end = text + strcspn(text, ":");
+	Rule r = {0, 0};
+
+	if (isdigit((unsigned char)*p) || *p == '/') {
+		// S/B notation: survival counts, a slash, birth counts
+		if (parse_counts(&p, &r.survive) != 0 || *p++ != '/'
+				|| parse_counts(&p, &r.birth) != 0) {
+			return -1;
+		}
+	}
+	else {
+		bool seen_birth = false, seen_survive = false;
+		for (int half = 0; half < 2; half++) {
+			if (half == 1 && *p++ != '/') {
+				return -1;
+			}
+			char letter = toupper((unsigned char)*p++);
+			if (letter == 'B' && !seen_birth) {
+				seen_birth = true;
+				if (parse_counts(&p, &r.birth) != 0) {
+					return -1;
+				}
+			}
+			else if (letter == 'S' && !seen_survive) {
+				seen_survive = true;
+				if (parse_counts(&p, &r.survive) != 0) {
+					return -1;
+				}
+			}
+			else {
+				return -1;
+			}
+		}
+	}
+
+	if (p != end) {
+		return -1;
+	}
+	*rule = r;
+	return 0;
+}
+
+void rule_format(const Rule *rule, char *text, size_t size) {
+	char buf[24];
+	int len = 0;
+	buf[len++] = 'B';
+	for (int n = 0; n <= 8; n++) {
+		if (rule->birth & (1 << n)) {
+			buf[len++] = '0' + n;
+		}
+	}
+	buf[len++] = '/';
+	buf[len++] = 'S';
+	for (int n = 0; n <= 8; n++) {
+		if (rule->survive & (1 << n)) {
+			buf[len++] = '0' + n;
+		}
+	}
+	buf[len] = '\0';
+	snprintf(text, size, "%s", buf);
+}
@@ -0,0 +1,53 @@
+#ifndef __RULE_H__
+#define __RULE_H__
+/**
+ * File: rule.h
+ *
+ * Outer-totalistic rules of the kind Life is one of: whether a cell is alive
+ * next turn only depends on whether it is alive now and how many of its
+ * eight neighbors are. Rules are written in B/S notation, the neighbor counts
+ * that bring a dead cell to life and those that keep a live one alive:
+ * Life is "B3/S23", HighLife "B36/S23", Seeds "B2/S".
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stddef.h>
+
+typedef struct Rule {
+	uint16_t birth;	// bit n set: a dead cell with n live neighbors is born
+	uint16_t survive;	// bit n set: a live cell with n live neighbors survives
+} Rule;
+
+// Conway's Life, B3/S23
+#define RULE_LIFE ((Rule){1 << 3, (1 << 2) | (1 << 3)})
+
+/**
+ * Parses a rule in B/S notation ("B36/S23", in any case, either half first)
+ * or in the older S/B notation ("23/36"). A bounded-grid suffix starting
+ * with ':' is ignored, since the world is always a torus.
+ *
+ * @param text The rule to parse.
+ * @param rule Location where to store the rule.
+ *
+ * @return 0 on success, -1 if text is not a rule.
+ */
+int rule_parse(const char *text, Rule *rule);
+
+/**
+ * Writes a rule in B/S notation, e.g. "B36/S23".
+ *
+ * @param rule The rule to write.
+ * @param text Location where to store the text.
+ * @param size The size of text; 22 bytes hold any rule.
+ */
+void rule_format(const Rule *rule, char *text, size_t size);
+
+/**
+ * Returns true if two rules are the same rule.
+ */
+static inline bool rule_equal(const Rule *a, const Rule *b) {
+	return a->birth == b->birth && a->survive == b->survive;
+}
+
+#endif
@@ -0,0 +1,1066 @@
+/**
+ * File: sim.c
+ *
+ * Multi-threaded simulation driver and the engines for the int-per-cell,
+ * byte-per-cell and bit-packed worlds.
+ */
+
+#define _GNU_SOURCE	// for CPU affinity
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <string.h>
+#include <stdbool.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <time.h>
+#ifdef HAVE_LIBNUMA
+#include <numa.h>
+#endif
+
+#include "gol.h"
+#include "bitworld.h"
+#include "byteworld.h"
+#include "sim.h"
+
+/*
+ * The int-per-cell world of gol.h, with its dimensions (update_world needs
+ * them but the Engine interface does not pass them).
+ */
+typedef struct IntWorld {
+	int num_cols;
+	int num_rows;
+	int *cells;
+} IntWorld;
+
+static void *int_create(int num_cols, int num_rows) {
+	IntWorld *iw = malloc(sizeof(IntWorld));
+	if (iw == NULL) {
+		return NULL;
+	}
+
+	iw->num_cols = num_cols;
+	iw->num_rows = num_rows;
+	iw->cells = calloc(world_size(num_cols, num_rows), sizeof(int));
+	if (iw->cells == NULL) {
+		free(iw);
+		return NULL;
+	}
+
+	return iw;
+}
+
+static void int_destroy(void *world) {
+	IntWorld *iw = world;
+	if (iw == NULL) {
+		return;
+	}
+	free(iw->cells);
+	free(iw);
+}
+
+static int int_get(const void *world, int col, int row) {
+	const IntWorld *iw = world;
+	return iw->cells[translate_to_1D(col, row, iw->num_cols, iw->num_rows)];
+}
+
+/*
+ * Sets a cell along with the halo cells that mirror it, so the world is
+ * ready to update without a separate update_halo pass.
+ */
+static void int_set(void *world, int col, int row, int alive) {
+	IntWorld *iw = world;
+	unsigned stride = iw->num_cols + 2;
+	// columns/rows (in halo coordinates, i.e. -1 to num_cols) holding this
+	// cell: itself, plus the opposite halo column/row if it is on an edge
+	int cols[3] = {col}, rows[3] = {row};
+	int num_cols = 1, num_rows = 1;
+
+	if (col == 0) {
+		cols[num_cols++] = iw->num_cols;
+	}
+	if (col == iw->num_cols - 1) {
+		cols[num_cols++] = -1;
+	}
+	if (row == 0) {
+		rows[num_rows++] = iw->num_rows;
+	}
+	if (row == iw->num_rows - 1) {
+		rows[num_rows++] = -1;
+	}
+
+	for (int r = 0; r < num_rows; r++) {
+		for (int c = 0; c < num_cols; c++) {
+			iw->cells[(rows[r] + 1)*stride + cols[c] + 1] = alive;
+		}
+	}
+}
+
+static int64_t int_count(const void *world, int col, int row, int num_cols, int num_rows) {
+	const IntWorld *iw = world;
+	unsigned stride = iw->num_cols + 2;
+	int64_t count = 0;
+	for (int y = row; y < row + num_rows; y++) {
+		const int *cells = iw->cells + (y + 1)*stride + col + 1;
+		for (int x = 0; x < num_cols; x++) {
+			count += cells[x];
+		}
+	}
+	return count;
+}
+
+static void int_copy(void *dst, const void *src) {
+	const IntWorld *from = src;
+	IntWorld *to = dst;
+	memcpy(to->cells, from->cells,
+			world_size(from->num_cols, from->num_rows)*sizeof(int));
+}
+
+static void int_copy_rows(void *dst, const void *src, int start_row, int end_row) {
+	const IntWorld *from = src;
+	IntWorld *to = dst;
+	unsigned stride = from->num_cols + 2;
+	memcpy(to->cells + (start_row + 1)*stride, from->cells + (start_row + 1)*stride,
+			(end_row - start_row + 1)*stride*sizeof(int));
+	update_halo(to->cells, to->num_cols, to->num_rows, start_row, end_row);
+}
+
+static void int_update(const void *curr, void *next, int start_row, int end_row) {
+	const IntWorld *from = curr;
+	IntWorld *to = next;
+	update_world(from->cells, to->cells, from->num_cols, from->num_rows, start_row, end_row);
+}
+
+const Engine int_engine = {
+	"int", int_create, int_destroy, int_get, int_count, int_set, int_copy, int_copy_rows,
+	NULL, int_update, NULL, NULL, set_rule,
+};
+
+static void *byte_create(int num_cols, int num_rows) {
+	return byteworld_create(num_cols, num_rows);
+}
+
+static void byte_destroy(void *world) {
+	byteworld_free(world);
+}
+
+static int byte_get(const void *world, int col, int row) {
+	return byteworld_get(world, col, row);
+}
+
+static int64_t byte_count(const void *world, int col, int row, int num_cols, int num_rows) {
+	return byteworld_count(world, col, row, num_cols, num_rows);
+}
+
+static void byte_set(void *world, int col, int row, int alive) {
+	byteworld_set(world, col, row, alive);
+}
+
+static void byte_copy(void *dst, const void *src) {
+	const ByteWorld *from = src;
+	byteworld_copy_rows(dst, from, 0, from->num_rows - 1);
+}
+
+static void byte_copy_rows(void *dst, const void *src, int start_row, int end_row) {
+	byteworld_copy_rows(dst, src, start_row, end_row);
+}
+
+static void byte_update(const void *curr, void *next, int start_row, int end_row) {
+	byteworld_update(curr, next, start_row, end_row);
+}
+
+const Engine byte_engine = {
+	"byte", byte_create, byte_destroy, byte_get, byte_count, byte_set, byte_copy, byte_copy_rows,
+	NULL, byte_update, NULL, NULL, byteworld_set_rule,
+};
+
+static void *bit_create(int num_cols, int num_rows) {
+	return bitworld_create(num_cols, num_rows);
+}
+
+static void bit_destroy(void *world) {
+	bitworld_free(world);
+}
+
+static int bit_get(const void *world, int col, int row) {
+	return bitworld_get(world, col, row);
+}
+
+static int64_t bit_count(const void *world, int col, int row, int num_cols, int num_rows) {
+	return bitworld_count(world, col, row, num_cols, num_rows);
+}
+
+static void bit_set(void *world, int col, int row, int alive) {
+	bitworld_set(world, col, row, alive);
+}
+
+static void bit_copy(void *dst, const void *src) {
+	bitworld_copy(dst, src);
+}
+
+static void bit_copy_rows(void *dst, const void *src, int start_row, int end_row) {
+	const BitWorld *from = src;
+	memcpy(bitworld_row(dst, start_row), bitworld_row(from, start_row),
+			(size_t)(end_row - start_row + 1) * from->words_per_row * sizeof(uint64_t));
+}
+
+static void bit_mark_all_changed(void *world) {
+	bitworld_mark_all_changed(world);
+}
+
+static void bit_update(const void *curr, void *next, int start_row, int end_row) {
+	bitworld_update(curr, next, start_row, end_row);
+}
+
+static void bit_update_block(const void *curr, void *next, int start_row, int end_row,
+		int generations, void *scratch) {
+	bitworld_update_block(curr, next, start_row, end_row, generations, scratch);
+}
+
+const Engine bit_engine = {
+	"bit", bit_create, bit_destroy, bit_get, bit_count, bit_set, bit_copy, bit_copy_rows,
+	bit_mark_all_changed, bit_update, bit_update_block, bitworld_block_scratch_size,
+	bitworld_set_rule,
+};
+
+void *engine_from_cells(const Engine *engine, int *world, int num_cols, int num_rows) {
+	void *w = engine->create(num_cols, num_rows);
+	if (w == NULL) {
+		return NULL;
+	}
+
+	for (int row = 0; row < num_rows; row++) {
+		for (int col = 0; col < num_cols; col++) {
+			if (world[translate_to_1D(col, row, num_cols, num_rows)] == 1) {
+				engine->set(w, col, row, 1);
+			}
+		}
+	}
+
+	return w;
+}
+
+void engine_to_cells(const Engine *engine, const void *src, int *world, int num_cols, int num_rows) {
+	for (int row = 0; row < num_rows; row++) {
+		for (int col = 0; col < num_cols; col++) {
+			unsigned index = translate_to_1D(col, row, num_cols, num_rows);
+			world[index] = engine->get(src, col, row);
+		}
+	}
+
+	update_halo(world, num_cols, num_rows, 0, num_rows - 1);
+}
+
+// most rows in a tile, the unit of work threads take from each other
+#define SIM_TILE_ROWS 16
+
+// what deque_take and deque_steal return when they get no task
+#define NO_TASK (-1)
+#define ABORT_TASK (-2)	// lost a race for the task; worth trying again
+
+/*
+ * Tasks are (step, tile) pairs: compute the rows of one tile for the
+ * generation(s) of the given step.
+ */
+static long long make_task(int step, int tile) {
+	return ((long long)step << 32) | tile;
+}
+
+/*
+ * A Chase-Lev work-stealing deque of tasks. Its owner pushes and takes tasks
+ * at the bottom, other threads steal them from the top. top and bottom sit
+ * on cache lines of their own since different threads write them.
+ */
+typedef struct TaskDeque {
+	_Alignas(64) atomic_llong top;
+	_Alignas(64) atomic_llong bottom;
+	atomic_llong *tasks;	// circular buffer of mask + 1 tasks
+	long long mask;
+} TaskDeque;
+
+/*
+ * Adds a task at the bottom of the deque. Only its owner may push, and the
+ * buffer must have room for it.
+ */
+static void deque_push(TaskDeque *dq, long long task) {
+	long long b = atomic_load_explicit(&dq->bottom, memory_order_relaxed);
+	atomic_store_explicit(&dq->tasks[b & dq->mask], task, memory_order_relaxed);
+	atomic_thread_fence(memory_order_release);
+	atomic_store_explicit(&dq->bottom, b + 1, memory_order_relaxed);
+}
+
+/*
+ * Removes the task at the bottom of the deque, or returns NO_TASK if it is
+ * empty. Only its owner may take.
+ */
+static long long deque_take(TaskDeque *dq) {
+	long long b = atomic_load_explicit(&dq->bottom, memory_order_relaxed) - 1;
+	atomic_store_explicit(&dq->bottom, b, memory_order_relaxed);
+	atomic_thread_fence(memory_order_seq_cst);
+	long long t = atomic_load_explicit(&dq->top, memory_order_relaxed);
+	if (t > b) {
+		atomic_store_explicit(&dq->bottom, b + 1, memory_order_relaxed);
+		return NO_TASK;
+	}
+
+	long long task = atomic_load_explicit(&dq->tasks[b & dq->mask], memory_order_relaxed);
+	if (t == b) {
+		//the last task; a thief may be taking it too
+		if (!atomic_compare_exchange_strong_explicit(&dq->top, &t, t + 1,
+				memory_order_seq_cst, memory_order_relaxed)) {
+			task = NO_TASK;
+		}
+		atomic_store_explicit(&dq->bottom, b + 1, memory_order_relaxed);
+	}
+	return task;
+}
+
+/*
+ * Removes the task at the top of the deque, unless it is for a step after
+ * max_step. Returns NO_TASK if it is empty (or the task is too late) and
+ * ABORT_TASK if another thread got the task first.
+ */
+static long long deque_steal(TaskDeque *dq, int max_step) {
+	long long t = atomic_load_explicit(&dq->top, memory_order_acquire);
+	atomic_thread_fence(memory_order_seq_cst);
+	long long b = atomic_load_explicit(&dq->bottom, memory_order_acquire);
+	if (t >= b) {
+		return NO_TASK;
+	}
+
+	long long task = atomic_load_explicit(&dq->tasks[t & dq->mask], memory_order_relaxed);
+	if ((task >> 32) > max_step) {
+		return NO_TASK;
+	}
+	if (!atomic_compare_exchange_strong_explicit(&dq->top, &t, t + 1,
+			memory_order_seq_cst, memory_order_relaxed)) {
+		return ABORT_TASK;
+	}
+	return task;
+}
+
+typedef struct SimPool SimPool;
+
+/*
+ * A snapshot being collected: each tile copies its rows into world as it
+ * finishes the snapshot's step, and the last one hands it back.
+ */
+typedef struct Snapshot {
+	atomic_int step;	// step the snapshot is taken after, or -1 if the slot
+						// is unused; world is set before it
+	void *world;	// NULL if the snapshot is skipped
+	int first_row;	// the rows to copy into world
+	int last_row;
+	atomic_int tiles_left;	// tiles yet to copy their rows
+} Snapshot;
+
+//declare the ThreadData fields
+struct ThreadData {
+	int id;
+	SimPool *pool;	// the pool this thread belongs to
+	const Engine *engine;
+	const void *start_world;	// the world to simulate
+	void *world;	// generation 0 (start_world, or the pool's copy of it);
+					// generations alternate with world_copy
+	void *world_copy;
+	int width;
+	int height;
+	int first_tile;	// the tiles this thread queues every step
+	int last_tile;	// (none if last_tile < first_tile)
+	const SimOptions *opts;
+	unsigned seed;	// picks which threads to steal from
+	int cpu;	// the CPU this thread is pinned to, or -1
+	int node;	// the NUMA node of that CPU, or -1 if not known
+	void *scratch;	// for the engine's update_block, kept across jobs
+	size_t scratch_size;
+};
+typedef struct ThreadData ThreadData;
+
+/*
+ * A long-lived set of worker threads. Jobs are posted under lock and run by
+ * thread_function on every thread; buffers are kept for the next job when
+ * they fit it.
+ */
+struct SimPool {
+	int num_threads;
+	pthread_t *tids;
+	ThreadData *td;
+	TaskDeque *deques;	// one per thread
+	pthread_mutex_t lock;
+	pthread_cond_t job_ready;	// a job was posted, or the pool is closing
+	pthread_cond_t job_done;	// every worker finished the current job
+	int jobs;	// number of jobs posted so far
+	int finished;	// workers done with the current job
+	int num_active;	// threads taking part in the current job
+	bool closing;
+	bool pinned;	// threads are pinned and simulate in their own copy of
+					// the world (home), placed on their nodes
+	atomic_int placed;	// threads done copying their rows into home
+	//the tiles and steps of the current job
+	int tile_rows;	// rows per tile (the last one may have more)
+	int num_tiles;
+	int block_turns;	// generations per step
+	int num_steps;
+	atomic_int *done;	// steps completed by each tile
+	size_t done_size;
+	atomic_llong *tasks;	// the buffers of the deques
+	size_t tasks_size;
+	//the second world buffer of the last job, reused if the next one has
+	//the same engine and dimensions
+	const Engine *copy_engine;
+	void *world_copy;
+	void *home;
+	int copy_width;
+	int copy_height;
+	atomic_int *tiles_finished;	// tiles done with each step, if timing them
+	size_t tiles_finished_size;
+	struct timespec *stamps;	// when the last tile of each step was done
+	size_t stamps_size;
+	//snapshots being collected, num_snap_slots for each of the job's
+	//SimSnapshots, by step modulo num_snap_slots. A tile is never more
+	//steps ahead of another than there are tiles, so no more snapshots
+	//than that are collected at once
+	Snapshot *snaps;
+	size_t snaps_size;
+	int num_snap_slots;
+};
+
+/*
+ * Spins until the given counter reaches at least target, yielding the CPU
+ * while waiting.
+ *
+ * @param counter The counter to watch
+ * @param target The value to wait for
+ */
+static void wait_for(atomic_int *counter, int target) {
+	while (atomic_load_explicit(counter, memory_order_acquire) < target) {
+		sched_yield();
+	}
+}
+
+/*
+ * Returns the number of seconds from start to end.
+ */
+static double elapsed(const struct timespec *start, const struct timespec *end) {
+	return (end->tv_sec - start->tv_sec) + (end->tv_nsec - start->tv_nsec) / 1e9;
+}
+
+/*
+ * Finds the rows of a tile. All tiles have tile_rows rows, except the last
+ * one which also takes whatever rows are left over.
+ */
+static void tile_bounds(const SimPool *pool, int tile, int height, int *start_row, int *end_row){
+	*start_row = tile * pool->tile_rows;
+	*end_row = (tile == pool->num_tiles - 1) ? height - 1 : *start_row + pool->tile_rows - 1;
+}
+
+/*
+ * Copies the rows of a tile that the snapshot of its step wants into it,
+ * if the step takes one (under lock, the first tile there asks for the
+ * world to copy into), and hands the snapshot over once it is complete.
+ *
+ * @param myargs The ThreadData of the thread that computed the tile
+ * @param k The index of the SimSnapshots in the options
+ * @param step The step the tile was computed for
+ * @param world_next The world the step was written into
+ * @param start_row First row of the tile
+ * @param end_row Last row of the tile
+ */
+static void snapshot_tile(ThreadData *myargs, int k, int step, const void *world_next, int start_row,
+		int end_row){
+	SimPool *pool = myargs->pool;
+	const SimSnapshots *snapshots = myargs->opts->snapshots[k];
+	int num_turns = myargs->opts->num_turns;
+	int before = step * pool->block_turns;
+	int after = before + pool->block_turns;
+	if(after > num_turns){
+		after = num_turns;
+	}
+	if(after == num_turns || after / snapshots->every == before / snapshots->every){
+		return;
+	}
+
+	//only the first tile of a step takes the lock, so snapshotting every
+	//turn does not have every tile queue up on it
+	Snapshot *slot = &pool->snaps[k * pool->num_snap_slots + step % pool->num_snap_slots];
+	if(atomic_load_explicit(&slot->step, memory_order_acquire) != step){
+		pthread_mutex_lock(&pool->lock);
+		if(atomic_load_explicit(&slot->step, memory_order_relaxed) != step){
+			slot->first_row = 0;
+			slot->last_row = myargs->height - 1;
+			slot->world = snapshots->acquire(snapshots->arg, after, &slot->first_row, &slot->last_row);
+			atomic_store(&slot->tiles_left, pool->num_tiles);
+			atomic_store_explicit(&slot->step, step, memory_order_release);
+		}
+		pthread_mutex_unlock(&pool->lock);
+	}
+	void *snap = slot->world;
+
+	int first = (start_row > slot->first_row) ? start_row : slot->first_row;
+	int last = (end_row < slot->last_row) ? end_row : slot->last_row;
+	if(snap != NULL && first <= last){
+		myargs->engine->copy_rows(snap, world_next, first, last);
+	}
+	if(atomic_fetch_sub(&slot->tiles_left, 1) == 1 && snap != NULL){
+		snapshots->release(snapshots->arg, snap, after);
+	}
+}
+
+/*
+ * Computes one tile for one step of the simulation, that is block_turns
+ * generations (or whatever is left of num_turns). Instead of a global
+ * barrier, each tile publishes how many steps it has completed, and a task
+ * only waits for its own tile and the two next to it (the only ones whose
+ * rows it reads, and the only ones reading its rows, since tiles are at
+ * least block_turns rows high) to be done with the previous step.
+ *
+ * @param myargs The ThreadData of the thread running the task
+ * @param task The task to run
+ */
+static void run_task(ThreadData *myargs, long long task){
+	SimPool *pool = myargs->pool;
+	const SimOptions *opts = myargs->opts;
+	int step = (int)(task >> 32);
+	int tile = (int)(task & 0xffffffff);
+	int n = pool->num_tiles;
+	int generations = opts->num_turns - step * pool->block_turns;
+	if(generations > pool->block_turns){
+		generations = pool->block_turns;
+	}
+	//even steps read generation 0's buffer and write the other one
+	const void *world = (step % 2 == 0) ? myargs->world : myargs->world_copy;
+	void *world_next = (step % 2 == 0) ? myargs->world_copy : myargs->world;
+
+	//our neighbors must have written their rows of this step's buffer,
+	//and must be done reading the other buffer before we overwrite it
+	wait_for(&pool->done[(tile + n - 1) % n], step);
+	wait_for(&pool->done[tile], step);
+	wait_for(&pool->done[(tile + 1) % n], step);
+
+	int start_row, end_row;
+	tile_bounds(pool, tile, myargs->height, &start_row, &end_row);
+	if(generations == 1){
+		myargs->engine->update(world, world_next, start_row, end_row);
+	}
+	else{
+		myargs->engine->update_block(world, world_next, start_row, end_row, generations,
+				myargs->scratch);
+	}
+	//the rows stay as they are until our neighbors are done with the next
+	//step, which needs this tile to be done with this one
+	for(int k = 0; k < SIM_MAX_SNAPSHOTS; k++){
+		if(opts->snapshots[k] != NULL){
+			snapshot_tile(myargs, k, step, world_next, start_row, end_row);
+		}
+	}
+
+	//the thread finishing the last tile of a step times it
+	if(opts->turn_seconds != NULL && atomic_fetch_add(&pool->tiles_finished[step], 1) == n - 1){
+		clock_gettime(CLOCK_MONOTONIC, &pool->stamps[step]);
+	}
+	atomic_store_explicit(&pool->done[tile], step + 1, memory_order_release);
+}
+
+/*
+ * Steals a task from another thread taking part in the job, trying each of
+ * them once. Returns NO_TASK if none had any left.
+ *
+ * Only tasks up to the thief's own step are taken: a later one could need a
+ * tile of the thief's that it has not even queued yet.
+ *
+ * @param myargs The ThreadData of the thief
+ * @param step The step the thief is on
+ */
+static long long steal_task(ThreadData *myargs, int step){
+	SimPool *pool = myargs->pool;
+	int n = pool->num_active;
+	//start at a random thread so thieves spread over their victims
+	int first = rand_r(&myargs->seed) % n;
+	for(int i = 0; i < n; i++){
+		int victim = (first + i) % n;
+		if(victim == myargs->id){
+			continue;
+		}
+		long long task;
+		do{
+			task = deque_steal(&pool->deques[victim], step);
+		}while(task == ABORT_TASK);
+		if(task != NO_TASK){
+			return task;
+		}
+	}
+	return NO_TASK;
+}
+
+/*
+ * This function runs the simulation on one thread. The world is split into
+ * tiles of a few rows, and every thread owns a contiguous run of them: each
+ * step it queues its own tiles, computes them, then steals tiles that other
+ * threads have not got to yet until none are left.
+ *
+ * @param args The ThreadData struct which contains the parameters to the thread
+ * function
+ */
+static void* thread_function(void* args){
+	ThreadData *myargs = (ThreadData*)args; //cast back to struct
+	SimPool *pool = myargs->pool;
+	const SimOptions *opts = myargs->opts;
+	TaskDeque *own = &pool->deques[myargs->id];
+	int start_row, end_row, unused;
+	tile_bounds(pool, myargs->first_tile, myargs->height, &start_row, &unused);
+	tile_bounds(pool, myargs->last_tile, myargs->height, &unused, &end_row);
+	int total_rows = end_row - start_row + 1; //calculate total rows
+	if(opts->verbose && myargs->cpu >= 0 && myargs->node >= 0){
+		fprintf(stdout, "\rid %d: rows: %d:%d (%d) cpu %d node %d\n", myargs-> id, start_row, end_row,
+				total_rows, myargs->cpu, myargs->node);
+	}
+	else if(opts->verbose && myargs->cpu >= 0){
+		fprintf(stdout, "\rid %d: rows: %d:%d (%d) cpu %d\n", myargs-> id, start_row, end_row,
+				total_rows, myargs->cpu);
+	}
+	else if(opts->verbose){
+		fprintf(stdout, "\rid %d: rows: %d:%d (%d)\n", myargs-> id, start_row, end_row, total_rows);
+	}
+	//a pinned thread is first to touch its rows of the pool's world, which
+	//puts their pages on its node; nobody starts until all rows are in
+	if(myargs->world != myargs->start_world){
+		if(myargs->last_tile >= myargs->first_tile){
+			myargs->engine->copy_rows(myargs->world, myargs->start_world, start_row, end_row);
+		}
+		atomic_fetch_add_explicit(&pool->placed, 1, memory_order_release);
+		wait_for(&pool->placed, pool->num_active);
+	}
+	//iterate through the steps
+	for (int step = 0; step < pool->num_steps; step++) {
+		//queue our tiles last first, so we go down the rows and thieves
+		//take the ones furthest from us
+		for(int tile = myargs->last_tile; tile >= myargs->first_tile; tile--){
+			deque_push(own, make_task(step, tile));
+		}
+		long long task;
+		while((task = deque_take(own)) != NO_TASK){
+			run_task(myargs, task);
+		}
+
+		//help the others with what they have left
+		while((task = steal_task(myargs, step)) != NO_TASK){
+			run_task(myargs, task);
+		}
+	}
+	return NULL;
+}
+
+/*
+ * Body of every pool thread: waits for a job, runs its share of it (if it
+ * takes part) and reports back, until the pool is freed.
+ *
+ * @param args The ThreadData struct of this thread
+ */
+static void* worker_function(void* args){
+	ThreadData *myargs = (ThreadData*)args;
+	SimPool *pool = myargs->pool;
+	int jobs_seen = 0;
+
+	pthread_mutex_lock(&pool->lock);
+	for(;;){
+		while(pool->jobs == jobs_seen && !pool->closing){
+			pthread_cond_wait(&pool->job_ready, &pool->lock);
+		}
+		if(pool->closing){
+			break;
+		}
+		jobs_seen = pool->jobs;
+		bool active = myargs->id < pool->num_active;
+		pthread_mutex_unlock(&pool->lock);
+
+		if(active){
+			thread_function(myargs);
+		}
+
+		pthread_mutex_lock(&pool->lock);
+		if(++pool->finished == pool->num_threads){
+			pthread_cond_signal(&pool->job_done);
+		}
+	}
+	pthread_mutex_unlock(&pool->lock);
+	return NULL;
+}
+
+/*
+ * Returns the NUMA node of a CPU, or -1 if it is not known.
+ */
+static int node_of_cpu(int cpu){
+#ifdef HAVE_LIBNUMA
+	if(numa_available() >= 0){
+		return numa_node_of_cpu(cpu);
+	}
+#endif
+	(void)cpu;
+	return -1;
+}
+
+/*
+ * Picks a CPU for each thread of the pool among those this process may run
+ * on. The threads are spread evenly over the NUMA nodes and in order, so
+ * threads owning neighboring rows share a node, and within a node they take
+ * its CPUs in turn.
+ */
+static void assign_cpus(SimPool *pool){
+	cpu_set_t allowed;
+	if(sched_getaffinity(0, sizeof(allowed), &allowed) != 0){
+		perror("sched_getaffinity");
+		exit(EXIT_FAILURE);
+	}
+
+	//the allowed CPUs, sorted by node (unknown nodes count as one node)
+	int cpus[CPU_SETSIZE], nodes[CPU_SETSIZE];
+	int num_cpus = 0;
+	for(int cpu = 0; cpu < CPU_SETSIZE; cpu++){
+		if(!CPU_ISSET(cpu, &allowed)){
+			continue;
+		}
+		int node = node_of_cpu(cpu);
+		int i = num_cpus++;
+		for(; i > 0 && nodes[i - 1] > node; i--){
+			cpus[i] = cpus[i - 1];
+			nodes[i] = nodes[i - 1];
+		}
+		cpus[i] = cpu;
+		nodes[i] = node;
+	}
+
+	//where each node's CPUs start in the sorted list
+	int first_cpu[CPU_SETSIZE + 1];
+	int num_nodes = 0;
+	for(int i = 0; i < num_cpus; i++){
+		if(i == 0 || nodes[i] != nodes[i - 1]){
+			first_cpu[num_nodes++] = i;
+		}
+	}
+	first_cpu[num_nodes] = num_cpus;
+
+	for(int i = 0; i < pool->num_threads; i++){
+		int n = (long)i * num_nodes / pool->num_threads;
+		int first_thread = ((long)n * pool->num_threads + num_nodes - 1) / num_nodes;
+		int on_node = first_cpu[n + 1] - first_cpu[n];
+		int k = first_cpu[n] + (i - first_thread) % on_node;
+		pool->td[i].cpu = cpus[k];
+		pool->td[i].node = nodes[k];
+	}
+}
+
+SimPool *sim_pool_create(int num_threads, bool pin_threads){
+	SimPool *pool = calloc(1, sizeof(SimPool));
+	if(pool == NULL){
+		return NULL;
+	}
+
+	pool->num_threads = num_threads;
+	pool->tids = malloc(sizeof(pthread_t)*num_threads);
+	pool->td = malloc(num_threads * sizeof(ThreadData));
+	//the deques must be aligned for their top and bottom to have cache
+	//lines of their own
+	void *deques = NULL;
+	if(posix_memalign(&deques, 64, num_threads * sizeof(TaskDeque)) != 0){
+		deques = NULL;
+	}
+	pool->deques = deques;
+	if(pool->tids == NULL || pool->td == NULL || pool->deques == NULL){
+		free(pool->tids);
+		free(pool->td);
+		free(pool->deques);
+		free(pool);
+		return NULL;
+	}
+	pthread_mutex_init(&pool->lock, NULL);
+	pthread_cond_init(&pool->job_ready, NULL);
+	pthread_cond_init(&pool->job_done, NULL);
+
+	for(int i = 0; i < num_threads; i++){
+		pool->td[i].id = i;
+		pool->td[i].pool = pool;
+		pool->td[i].seed = i;
+		pool->td[i].cpu = -1;
+		pool->td[i].node = -1;
+		pool->td[i].scratch = NULL;
+		pool->td[i].scratch_size = 0;
+	}
+	pool->pinned = pin_threads;
+	if(pin_threads){
+		assign_cpus(pool);
+	}
+
+	//create threads (already on their CPU, if pinned) and check for failure
+	for(int i = 0; i < num_threads; i++){
+		pthread_attr_t attr;
+		pthread_attr_init(&attr);
+		if(pin_threads){
+			cpu_set_t cpu;
+			CPU_ZERO(&cpu);
+			CPU_SET(pool->td[i].cpu, &cpu);
+			pthread_attr_setaffinity_np(&attr, sizeof(cpu), &cpu);
+		}
+		if(pthread_create(&pool->tids[i], &attr, worker_function, &pool->td[i]) != 0){
+			perror("pthread_create");
+			exit(EXIT_FAILURE);
+		}
+		pthread_attr_destroy(&attr);
+	}
+	return pool;
+}
+
+/*
+ * Returns buffer if it already holds at least size bytes, or a new buffer of
+ * that size otherwise (freeing the old one). Exits if memory runs out.
+ */
+static void *reuse_buffer(void *buffer, size_t *capacity, size_t size){
+	if(size <= *capacity){
+		return buffer;
+	}
+	free(buffer);
+	buffer = malloc(size);
+	if(buffer == NULL){
+		perror("sim_pool_run");
+		exit(EXIT_FAILURE);
+	}
+	*capacity = size;
+	return buffer;
+}
+
+/*
+ * Splits the world into tiles, deals them out to the pool's threads and
+ * waits for them to finish.
+ */
+void sim_pool_run(SimPool *pool, const Engine *engine, void *world, int width, int height, const SimOptions *opts){
+	int num_active = opts->num_threads;
+	int num_turns = opts->num_turns;
+
+	if(num_active > pool->num_threads){
+		fprintf(stderr, "sim_pool_run: %d threads asked but the pool has %d\n", num_active, pool->num_threads);
+		exit(EXIT_FAILURE);
+	}
+
+	//the second world buffer (and the pinned threads' copy of the world),
+	//kept from the last job if it fits this one
+	if(pool->copy_engine != engine || pool->copy_width != width || pool->copy_height != height){
+		if(pool->world_copy != NULL){
+			pool->copy_engine->destroy(pool->world_copy);
+		}
+		if(pool->home != NULL){
+			pool->copy_engine->destroy(pool->home);
+		}
+		pool->world_copy = engine->create(width, height);
+		pool->home = pool->pinned ? engine->create(width, height) : NULL;
+		if(pool->world_copy == NULL || (pool->pinned && pool->home == NULL)){
+			perror("sim_pool_run");
+			exit(EXIT_FAILURE);
+		}
+		pool->copy_engine = engine;
+		pool->copy_width = width;
+		pool->copy_height = height;
+	}
+	//a step computes block_turns generations of a tile from the rows up to
+	//block_turns away from it, which must all be in the tiles next to it.
+	//Some engines only do one generation at once
+	int block_turns = 1;
+	if(engine->update_block != NULL && opts->block_turns > 1){
+		block_turns = opts->block_turns;
+	}
+	int num_steps = (num_turns + block_turns - 1) / block_turns;
+	pool->block_turns = block_turns;
+	pool->num_steps = num_steps;
+
+	//small boards still get a few tiles per thread to even out the load.
+	//Taller tiles waste less on the rows around them that a step computes
+	//and throws away
+	int max_tile_rows = SIM_TILE_ROWS;
+	if(8 * block_turns > max_tile_rows){
+		max_tile_rows = 8 * block_turns;
+	}
+	int tile_rows = height / (4 * num_active);
+	if(tile_rows > max_tile_rows){
+		tile_rows = max_tile_rows;
+	}
+	if(tile_rows < block_turns){
+		tile_rows = block_turns;
+	}
+	if(tile_rows < 1){
+		tile_rows = 1;
+	}
+	int num_tiles = height / tile_rows;
+	if(num_tiles < 1){
+		num_tiles = 1;
+	}
+	pool->tile_rows = tile_rows;
+	pool->num_tiles = num_tiles;
+
+	//per-tile step counters
+	pool->done = reuse_buffer(pool->done, &pool->done_size, num_tiles * sizeof(atomic_int));
+	for(int i = 0; i < num_tiles; i++){
+		atomic_init(&pool->done[i], 0);
+	}
+	//per-step tile counts, to time the generations, if timing them
+	struct timespec start_time;
+	if(opts->turn_seconds != NULL){
+		pool->tiles_finished = reuse_buffer(pool->tiles_finished, &pool->tiles_finished_size,
+				num_steps * sizeof(atomic_int));
+		pool->stamps = reuse_buffer(pool->stamps, &pool->stamps_size,
+				num_steps * sizeof(struct timespec));
+		for(int t = 0; t < num_steps; t++){
+			atomic_init(&pool->tiles_finished[t], 0);
+		}
+	}
+
+	//slots for the snapshots being collected, if taking any
+	pool->num_snap_slots = num_tiles + 1;
+	for(int k = 0; k < SIM_MAX_SNAPSHOTS; k++){
+		if(opts->snapshots[k] != NULL){
+			pool->snaps = reuse_buffer(pool->snaps, &pool->snaps_size,
+					SIM_MAX_SNAPSHOTS * pool->num_snap_slots * sizeof(Snapshot));
+			for(int i = 0; i < SIM_MAX_SNAPSHOTS * pool->num_snap_slots; i++){
+				atomic_init(&pool->snaps[i].step, -1);
+			}
+			break;
+		}
+	}
+
+	//threads own contiguous runs of tiles whose sizes differ by at most one.
+	//A deque holds at most one step of its owner's tiles at a time
+	int tiles_per_thread = num_tiles / num_active;
+	int remainder = num_tiles % num_active;
+	long long capacity = 1;
+	while(capacity < tiles_per_thread + (remainder > 0)){
+		capacity *= 2;
+	}
+	pool->tasks = reuse_buffer(pool->tasks, &pool->tasks_size,
+			(size_t)num_active * capacity * sizeof(atomic_llong));
+	int cur = 0;
+	for(int i=0; i < num_active; i++){
+		int count = tiles_per_thread + (i < remainder);
+
+		TaskDeque *dq = &pool->deques[i];
+		atomic_init(&dq->top, 0);
+		atomic_init(&dq->bottom, 0);
+		dq->tasks = pool->tasks + (size_t)i * capacity;
+		dq->mask = capacity - 1;
+
+		//these lines initialize the struct fields of this thread's tiles
+		ThreadData *td = &pool->td[i];
+		td->engine = engine;
+		td->start_world = world;
+		td->world = pool->pinned ? pool->home : world;
+		td->world_copy = pool->world_copy;
+		td->width = width;
+		td->height = height;
+		td->opts = opts;
+		td->first_tile = cur;
+		td->last_tile = cur + count - 1;
+		cur += count;
+		//any thread may end up with the last tile, the tallest one
+		if(block_turns > 1){
+			td->scratch = reuse_buffer(td->scratch, &td->scratch_size,
+					engine->block_scratch_size(width, height - (num_tiles - 1) * tile_rows, block_turns));
+		}
+	}
+	//world_copy holds some other world, so whatever world last tracked as
+	//changed is not relative to it
+	void *first = pool->pinned ? pool->home : world;
+	if(engine->mark_all_changed != NULL){
+		engine->mark_all_changed(first);
+	}
+	atomic_init(&pool->placed, 0);
+	clock_gettime(CLOCK_MONOTONIC, &start_time);
+
+	//post the job and wait for every worker to be done with it
+	pthread_mutex_lock(&pool->lock);
+	pool->num_active = num_active;
+	pool->finished = 0;
+	pool->jobs++;
+	pthread_cond_broadcast(&pool->job_ready);
+	while(pool->finished < pool->num_threads){
+		pthread_cond_wait(&pool->job_done, &pool->lock);
+	}
+	pthread_mutex_unlock(&pool->lock);
+
+	//a step is finished once its last tile is; every tile finishes a step
+	//after its previous one, so these times only ever grow. The generations
+	//of a step share its time
+	if(opts->turn_seconds != NULL){
+		double prev = 0;
+		for(int t = 0; t < num_steps; t++){
+			double finished = elapsed(&start_time, &pool->stamps[t]);
+			int generations = num_turns - t * block_turns;
+			if(generations > block_turns){
+				generations = block_turns;
+			}
+			for(int g = 0; g < generations; g++){
+				opts->turn_seconds[t * block_turns + g] = (finished - prev) / generations;
+			}
+			prev = finished;
+		}
+	}
+
+	//after an odd number of steps the final generation is in the second
+	//buffer, and pinned threads left it in the pool's world either way
+	if(num_steps % 2 == 1){
+		engine->copy(world, pool->world_copy);
+	}
+	else if(first != world){
+		engine->copy(world, first);
+	}
+}
+
+void sim_pool_free(SimPool *pool){
+	if(pool == NULL){
+		return;
+	}
+
+	pthread_mutex_lock(&pool->lock);
+	pool->closing = true;
+	pthread_cond_broadcast(&pool->job_ready);
+	pthread_mutex_unlock(&pool->lock);
+	//join threads and check for failure
+	for(int i = 0; i < pool->num_threads; i++){
+		if(pthread_join(pool->tids[i], NULL) != 0){
+			perror("pthread_join");
+			exit(EXIT_FAILURE);
+		}
+	}
+
+	if(pool->world_copy != NULL){
+		pool->copy_engine->destroy(pool->world_copy);
+	}
+	if(pool->home != NULL){
+		pool->copy_engine->destroy(pool->home);
+	}
+	pthread_cond_destroy(&pool->job_done);
+	pthread_cond_destroy(&pool->job_ready);
+	pthread_mutex_destroy(&pool->lock);
+	free(pool->stamps);
+	free(pool->tiles_finished);
+	free(pool->snaps);
+	free(pool->tasks);
+	free(pool->done);
+	for(int i = 0; i < pool->num_threads; i++){
+		free(pool->td[i].scratch);
+	}
+	free(pool->deques);
+	free(pool->td);
+	free(pool->tids);
+	free(pool);
+}
+
+/*
+ * Runs a single simulation on a pool of its own.
+ */
+void run_threads(const Engine *engine, void *world, int width, int height, const SimOptions *opts){
+	SimPool *pool = sim_pool_create(opts->num_threads, opts->pin_threads);
+	if(pool == NULL){
+		perror("run_threads");
+		exit(EXIT_FAILURE);
+	}
+	sim_pool_run(pool, engine, world, width, height, opts);
+	sim_pool_free(pool);
+}
@@ -0,0 +1,219 @@
+#ifndef __SIM_H__
+#define __SIM_H__
+/**
+ * File: sim.h
+ *
+ * Multi-threaded simulation driver. The world is split into tiles of a few
+ * rows that threads take from each other as they run out of their own, and
+ * can be stored in any representation that has an Engine.
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stddef.h>
+
+#include "rule.h"
+
+/**
+ * A world representation together with the kernel that updates it. Worlds
+ * are opaque to the driver; they are only handled through these functions.
+ */
+typedef struct Engine {
+	const char *name;
+
+	/** Creates an empty (all dead) world, or returns NULL on failure. */
+	void *(*create)(int num_cols, int num_rows);
+
+	/** Frees a world created by create. */
+	void (*destroy)(void *world);
+
+	/** Returns 1 if the cell at (col, row) is alive, 0 otherwise. */
+	int (*get)(const void *world, int col, int row);
+
+	/**
+	 * Returns the number of live cells in the num_cols by num_rows block
+	 * whose top-left cell is (col, row), which must be inside the world.
+	 */
+	int64_t (*count)(const void *world, int col, int row, int num_cols, int num_rows);
+
+	/** Sets the cell at (col, row) to alive (1) or dead (0). */
+	void (*set)(void *world, int col, int row, int alive);
+
+	/** Copies all cells of src into dst (same dimensions). */
+	void (*copy)(void *dst, const void *src);
+
+	/** Copies rows start_row through end_row of src into dst. */
+	void (*copy_rows)(void *dst, const void *src, int start_row, int end_row);
+
+	/**
+	 * Forgets what the last update changed, for engines that only
+	 * recompute the parts of the world that changed (NULL for the others).
+	 * Called on the world before its first update into a new buffer.
+	 */
+	void (*mark_all_changed)(void *world);
+
+	/**
+	 * Computes rows start_row through end_row of the next generation. next
+	 * must be the world curr was computed from, unless mark_all_changed was
+	 * called on curr since; engines that skip unchanged cells rely on it.
+	 */
+	void (*update)(const void *curr, void *next, int start_row, int end_row);
+
+	/**
+	 * Like update but computes several generations at once, reading the
+	 * rows up to generations away from the band in curr and writing only
+	 * the last generation into next (NULL if the engine cannot).
+	 */
+	void (*update_block)(const void *curr, void *next, int start_row, int end_row,
+			int generations, void *scratch);
+
+	/**
+	 * Returns the bytes of scratch space update_block needs to compute up
+	 * to generations generations of up to num_rows rows of a world num_cols
+	 * wide (NULL if the engine has no update_block). Each thread passes a
+	 * buffer of its own, kept from one call to the next.
+	 */
+	size_t (*block_scratch_size)(int num_cols, int num_rows, int generations);
+
+	/**
+	 * Sets the rule update and update_block simulate, for every world of
+	 * the engine. Called before any thread starts updating.
+	 */
+	void (*set_rule)(const Rule *rule);
+} Engine;
+
+// the original int-per-cell world (see gol.h)
+extern const Engine int_engine;
+
+// the byte-per-cell world (see byteworld.h)
+extern const Engine byte_engine;
+
+// the bit-packed world (see bitworld.h), using the selected bitworld kernel
+extern const Engine bit_engine;
+
+/**
+ * Where a simulation hands periodic snapshots of its world (see
+ * checkpoint.h for one that saves them, and render.h for one that shows
+ * them). Neither function may block: they are called by the simulating
+ * threads.
+ */
+typedef struct SimSnapshots {
+	int every;	// generations between snapshots
+
+	/**
+	 * Returns a world (of the simulated engine and size) to copy the
+	 * snapshot after the given number of turns into, or NULL to skip it.
+	 * first_row and last_row start out as the first and last row of the
+	 * world; only the rows between them (which acquire may narrow) are
+	 * copied.
+	 */
+	void *(*acquire)(void *arg, int turn, int *first_row, int *last_row);
+
+	/** Takes back a world once the snapshot in it is complete. */
+	void (*release)(void *arg, void *world, int turn);
+
+	void *arg;	// passed to acquire and release
+} SimSnapshots;
+
+// most SimSnapshots a simulation hands snapshots to
+#define SIM_MAX_SNAPSHOTS 2
+
+/**
+ * Options for run_threads.
+ */
+typedef struct SimOptions {
+	int num_threads;	// number of threads
+	int num_turns;	// number of generations to simulate
+	bool verbose;	// print the rows each thread starts with to stdout
+	double *turn_seconds;	// if not NULL, receives the wall time of each
+							// of the num_turns generations
+	int block_turns;	// generations per visit of a tile, 1 to 64, for
+						// engines with update_block
+	bool pin_threads;	// pin the threads of run_threads to CPUs (see
+						// sim_pool_create)
+	// each one that is not NULL receives a snapshot after every
+	// snapshots[i]->every turns (or the first step past them, when steps
+	// are several turns), but the last
+	const SimSnapshots *snapshots[SIM_MAX_SNAPSHOTS];
+} SimOptions;
+
+/**
+ * Creates a world for the given engine from an int-per-cell world returned
+ * by initialize_world.
+ *
+ * @param engine The engine of the world to create.
+ * @param world The int-per-cell world.
+ * @param num_cols The width of the world.
+ * @param num_rows The height of the world.
+ *
+ * @return The new world, or NULL if it could not be allocated.
+ */
+void *engine_from_cells(const Engine *engine, int *world, int num_cols, int num_rows);
+
+/**
+ * Stores the cells of an engine's world into an int-per-cell world.
+ *
+ * @param engine The engine of the world to read.
+ * @param src The world to read.
+ * @param world Location where to store the cells (world_size ints).
+ * @param num_cols The width of the world.
+ * @param num_rows The height of the world.
+ */
+void engine_to_cells(const Engine *engine, const void *src, int *world, int num_cols, int num_rows);
+
+/**
+ * A set of worker threads that can run many simulations, one after the
+ * other, without creating new threads or buffers for each of them.
+ */
+typedef struct SimPool SimPool;
+
+/**
+ * Starts a pool of worker threads.
+ *
+ * Pinned threads are spread evenly over the NUMA nodes (as reported by
+ * libnuma, when built with it) of the CPUs this process may run on, and
+ * each one copies the rows it starts out with into a world owned by the
+ * pool, so the pages of those rows are on its own node. The verbose output
+ * of sim_pool_run shows the CPU and node of each thread.
+ *
+ * @param num_threads The number of threads.
+ * @param pin_threads Whether to pin each thread to a CPU.
+ *
+ * @return The new pool, or NULL if it could not be allocated.
+ */
+SimPool *sim_pool_create(int num_threads, bool pin_threads);
+
+/**
+ * Simulates the world for opts->num_turns generations on the pool's
+ * threads, opts->num_threads of them (at most as many as the pool has). Returns once the simulation is done. The pool's
+ * buffers are kept for the next simulation.
+ *
+ * @param pool The pool to run on.
+ * @param engine The engine of the world.
+ * @param world The world to simulate; holds the final generation on return.
+ * @param width Total number of columns
+ * @param height Total number of rows
+ * @param opts The simulation options.
+ */
+void sim_pool_run(SimPool *pool, const Engine *engine, void *world, int width, int height, const SimOptions *opts);
+
+/**
+ * Stops the pool's threads and frees it.
+ *
+ * @param pool The pool to free.
+ */
+void sim_pool_free(SimPool *pool);
+
+/**
+ * Simulates the world for opts->num_turns generations with opts->num_threads
+ * threads. Equivalent to running it on a pool created and freed just for it.
+ *
+ * @param engine The engine of the world.
+ * @param world The world to simulate; holds the final generation on return.
+ * @param width Total number of columns
+ * @param height Total number of rows
+ * @param opts The simulation options.
+ */
+void run_threads(const Engine *engine, void *world, int width, int height, const SimOptions *opts);
+
+#endif